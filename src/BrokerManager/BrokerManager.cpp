@@ -0,0 +1,232 @@
+#include "BrokerManager.h"
+#include "Clock/Clock.h"
+#include <WiFi.h>
+
+BrokerManager brokerManager;
+
+void BrokerManager::initialize(PreferencesManager &prefs)
+{
+    preferences = &prefs;
+    if (!setBrokers(preferences->getBrokers()))
+        setBrokers(DEFAULT_BROKERS);
+}
+
+// Expects [{"host": "10.0.0.5", "port": 1883}, ...] in order of preference
+bool BrokerManager::setBrokers(const String &json)
+{
+    JsonDocument doc;
+    if (deserializeJson(doc, json) || !doc.is<JsonArray>())
+        return false;
+
+    int count = 0;
+    Broker parsed[MAX_BROKERS];
+    for (JsonObject item : doc.as<JsonArray>())
+    {
+        if (count >= MAX_BROKERS)
+            break;
+        String host = item["host"] | "";
+        if (host == "")
+            continue;
+        parsed[count].host = host;
+        parsed[count].port = item["port"] | 1883;
+        parsed[count].consecutiveFailures = 0;
+        parsed[count].lastFailure = 0;
+        parsed[count].connectLatencyMs = 0;
+        parsed[count].probeLatencyMs = 0;
+        parsed[count].rttMs = 0;
+        count++;
+    }
+    if (count == 0)
+        return false;
+
+    for (int i = 0; i < count; i++)
+        brokers[i] = parsed[i];
+    brokerCount = count;
+    currentIndex = 0;
+    generation++; // Results of a probe still running refer to the old list
+    selectedAt = systemClock().now();
+    lastProbe = selectedAt;
+
+    Serial.println("🛰️ " + String(brokerCount) + " MQTT broker(s) configured, primary " +
+                   brokers[0].host + ":" + String(brokers[0].port));
+    return true;
+}
+
+bool BrokerManager::isHealthy(int index, unsigned long now) const
+{
+    const Broker &broker = brokers[index];
+    return broker.consecutiveFailures < FAILOVER_THRESHOLD || now - broker.lastFailure >= FAILURE_BACKOFF_MS;
+}
+
+void BrokerManager::updateAverage(float &average, float sample)
+{
+    average = average == 0 ? sample : average + 0.25f * (sample - average);
+}
+
+void BrokerManager::select(int index, unsigned long now, const char *reason)
+{
+    if (index == currentIndex)
+        return;
+    currentIndex = index;
+    selectedAt = now;
+    failovers++;
+    Serial.println("🛰️ Switching to broker " + brokers[index].host + ":" + String(brokers[index].port) +
+                   " (" + reason + ")");
+}
+
+void BrokerManager::reportConnectResult(bool connected, unsigned long latencyMs, unsigned long now)
+{
+    Broker &broker = brokers[currentIndex];
+    if (connected)
+    {
+        broker.consecutiveFailures = 0;
+        updateAverage(broker.connectLatencyMs, latencyMs);
+        return;
+    }
+
+    broker.lastFailure = now;
+    if (broker.consecutiveFailures < 255)
+        broker.consecutiveFailures++;
+    if (broker.consecutiveFailures < FAILOVER_THRESHOLD)
+        return;
+
+    // Next healthy broker in configured order; stay put if none is healthy
+    for (int step = 1; step < brokerCount; step++)
+    {
+        int candidate = (currentIndex + step) % brokerCount;
+        if (isHealthy(candidate, now))
+        {
+            select(candidate, now, "connect failures");
+            return;
+        }
+    }
+}
+
+void BrokerManager::reportRtt(unsigned long rttMs)
+{
+    updateAverage(brokers[currentIndex].rttMs, rttMs);
+}
+
+bool BrokerManager::probe(unsigned long now)
+{
+    if (probeRunning)
+        return probeDone && finishProbe(now);
+    if (isProbeDue(now))
+        startProbe(now);
+    return false;
+}
+
+bool BrokerManager::startProbe(unsigned long now)
+{
+    lastProbe = now;
+
+    // The task works on copies, so setBrokers() may replace the list while it runs
+    probeTargetCount = 0;
+    for (int i = 0; i < brokerCount; i++)
+    {
+        // The current broker is probed too, so all candidates are measured the same way
+        if (i != currentIndex && !isHealthy(i, now))
+            continue;
+        ProbeTarget &target = probeTargets[probeTargetCount++];
+        strlcpy(target.host, brokers[i].host.c_str(), sizeof(target.host));
+        target.port = brokers[i].port;
+        target.index = i;
+        target.latencyMs = -1;
+    }
+    if (probeTargetCount == 0)
+        return false;
+
+    probeGeneration = generation;
+    probeDone = false;
+    probeRunning = true;
+    // Core 0, like the OTA download: a connect to a dead broker blocks for PROBE_TIMEOUT_MS
+    if (xTaskCreatePinnedToCore(probeTaskEntry, "probe", 4096, this, 1, nullptr, 0) != pdPASS)
+    {
+        probeRunning = false;
+        Serial.println("⚠️ Broker probe task create failed");
+        return false;
+    }
+    return true;
+}
+
+void BrokerManager::probeTaskEntry(void *param)
+{
+    static_cast<BrokerManager *>(param)->runProbe();
+    vTaskDelete(nullptr);
+}
+
+void BrokerManager::runProbe()
+{
+    WiFiClient probeClient;
+    for (int i = 0; i < probeTargetCount; i++)
+    {
+        ProbeTarget &target = probeTargets[i];
+        unsigned long start = millis();
+        bool reachable = probeClient.connect(target.host, target.port, PROBE_TIMEOUT_MS);
+        unsigned long latency = millis() - start;
+        probeClient.stop();
+        target.latencyMs = reachable ? (long)latency : -1;
+    }
+    probeDone = true;
+}
+
+bool BrokerManager::finishProbe(unsigned long now)
+{
+    probeRunning = false;
+    if (probeGeneration != generation)
+        return false;
+
+    for (int t = 0; t < probeTargetCount; t++)
+    {
+        const ProbeTarget &target = probeTargets[t];
+        int i = target.index;
+        if (target.latencyMs >= 0)
+        {
+            brokers[i].consecutiveFailures = 0;
+            updateAverage(brokers[i].probeLatencyMs, target.latencyMs);
+        }
+        else if (i != currentIndex)
+        {
+            brokers[i].lastFailure = now;
+            brokers[i].consecutiveFailures = FAILOVER_THRESHOLD;
+        }
+    }
+
+    if (now - selectedAt < MIN_DWELL_MS)
+        return false;
+
+    float best = brokers[currentIndex].probeLatencyMs;
+    int bestIndex = currentIndex;
+    for (int i = 0; i < brokerCount; i++)
+    {
+        if (i == currentIndex || !isHealthy(i, now) || brokers[i].probeLatencyMs == 0)
+            continue;
+        float latency = brokers[i].probeLatencyMs;
+        if (best == 0 || (latency < best * SWITCH_RATIO && best - latency >= SWITCH_MIN_GAIN_MS))
+        {
+            best = latency;
+            bestIndex = i;
+        }
+    }
+
+    if (bestIndex == currentIndex)
+        return false;
+    select(bestIndex, now, "lower latency");
+    return true;
+}
+
+void BrokerManager::fillMetrics(JsonObject metrics)
+{
+    metrics["current"] = brokers[currentIndex].host + ":" + String(brokers[currentIndex].port);
+    metrics["failovers"] = failovers;
+    JsonArray list = metrics["brokers"].to<JsonArray>();
+    for (int i = 0; i < brokerCount; i++)
+    {
+        JsonObject item = list.add<JsonObject>();
+        item["host"] = brokers[i].host;
+        item["connectMs"] = (int)brokers[i].connectLatencyMs;
+        item["probeMs"] = (int)brokers[i].probeLatencyMs;
+        item["rttMs"] = (int)brokers[i].rttMs;
+        item["failures"] = brokers[i].consecutiveFailures;
+    }
+}
@@ -0,0 +1,90 @@
+#ifndef BROKER_MANAGER_H
+#define BROKER_MANAGER_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include "PreferencesManager/PreferencesManager.h"
+
+// Ordered list of MQTT brokers with health tracking. Fails over after repeated connect
+// failures and moves to a measurably faster broker, with hysteresis so the device does
+// not flap between brokers of similar latency.
+class BrokerManager
+{
+public:
+    struct Broker
+    {
+        String host;
+        uint16_t port;
+        uint8_t consecutiveFailures;
+        unsigned long lastFailure;
+        float connectLatencyMs; // EWMA of full MQTT connects, 0 = not measured yet
+        float probeLatencyMs;   // EWMA of TCP connect probes, comparable across brokers
+        float rttMs;            // EWMA of MQTT round trips, current broker only
+    };
+
+    void initialize(PreferencesManager &prefs);
+    bool setBrokers(const String &json);
+    const Broker &current() const { return brokers[currentIndex]; }
+    int getCurrentIndex() const { return currentIndex; }
+
+    void reportConnectResult(bool connected, unsigned long latencyMs, unsigned long now);
+    void reportRtt(unsigned long rttMs);
+
+    // Periodically measures TCP connect latency to every healthy broker. The connects run
+    // on a background task, one broker after another, so the caller's loop never waits on
+    // them. Call every pass; returns true once a finished probe selected a faster healthy
+    // broker and the caller should reconnect.
+    bool isProbeDue(unsigned long now) const
+    {
+        return brokerCount > 1 && !probeRunning && now - lastProbe >= PROBE_INTERVAL_MS;
+    }
+    bool probe(unsigned long now);
+    void fillMetrics(JsonObject metrics);
+
+    static const int MAX_BROKERS = 4;
+    static const int FAILOVER_THRESHOLD = 2;
+    static const unsigned long FAILURE_BACKOFF_MS = 60000;
+    static const unsigned long PROBE_INTERVAL_MS = 600000;
+    static const unsigned long MIN_DWELL_MS = 300000;
+    static const uint32_t PROBE_TIMEOUT_MS = 1000;
+    static constexpr float SWITCH_RATIO = 0.7f; // Candidate must be 30% faster
+    static constexpr float SWITCH_MIN_GAIN_MS = 20.0f;
+
+private:
+    struct ProbeTarget
+    {
+        char host[64];
+        uint16_t port;
+        int8_t index;
+        long latencyMs; // -1 = unreachable
+    };
+
+    static void probeTaskEntry(void *param);
+    void runProbe();
+    bool startProbe(unsigned long now);
+    bool finishProbe(unsigned long now);
+    bool isHealthy(int index, unsigned long now) const;
+    void select(int index, unsigned long now, const char *reason);
+    static void updateAverage(float &average, float sample);
+
+    PreferencesManager *preferences = nullptr;
+    Broker brokers[MAX_BROKERS];
+    int brokerCount = 0;
+    int currentIndex = 0;
+    unsigned long selectedAt = 0;
+    unsigned long lastProbe = 0;
+    uint32_t failovers = 0;
+
+    // Owned by the probe task between startProbe() and probeDone
+    ProbeTarget probeTargets[MAX_BROKERS];
+    int probeTargetCount = 0;
+    uint32_t probeGeneration = 0; // Broker list the running probe was started against
+    uint32_t generation = 0;      // Bumped by setBrokers()
+    bool probeRunning = false;
+    volatile bool probeDone = false;
+    const char *DEFAULT_BROKERS = "[{\"host\":\"34.229.153.185\",\"port\":1883}]";
+};
+
+extern BrokerManager brokerManager; // Declaration only
+
+#endif
@@ -0,0 +1,28 @@
+#include "Clock.h"
+
+// The device build defines this in HardwareClock.cpp
+Clock &defaultClock();
+
+static Clock *activeClock = nullptr;
+
+Clock &systemClock()
+{
+    return activeClock ? *activeClock : defaultClock();
+}
+
+// Call before initialize() of any module that stores timestamps
+void setSystemClock(Clock &source)
+{
+    activeClock = &source;
+}
+
+#ifndef ARDUINO
+#include "SimulatedClock.h"
+
+// Host builds have no hardware timer: time stands still until a test installs its own clock
+Clock &defaultClock()
+{
+    static SimulatedClock stopped;
+    return stopped;
+}
+#endif
@@ -0,0 +1,33 @@
+#ifndef CLOCK_H
+#define CLOCK_H
+
+// Millisecond time source for everything that schedules: relay timers, intervals, backoff,
+// debounce windows. Hardware-backed on the device; a SimulatedClock can be swapped in so a
+// host build fast-forwards days of operation, including the 49.7-day millis() rollover.
+//
+// Times are unsigned and wrap. Compare them with the helpers below, never with < or >=
+// on two absolute timestamps.
+class Clock
+{
+public:
+    virtual ~Clock() {}
+    virtual unsigned long now() const = 0;
+
+    // True once now has reached deadline, correct across a wrap as long as the two are
+    // less than 24.8 days apart
+    static bool hasReached(unsigned long now, unsigned long deadline)
+    {
+        return (long)(now - deadline) >= 0;
+    }
+
+    static unsigned long getRemaining(unsigned long now, unsigned long deadline)
+    {
+        return hasReached(now, deadline) ? 0 : deadline - now;
+    }
+};
+
+// The clock every module reads; the hardware clock unless replaced
+Clock &systemClock();
+void setSystemClock(Clock &source);
+
+#endif
@@ -0,0 +1,9 @@
+#ifdef ARDUINO
+#include "HardwareClock.h"
+
+Clock &defaultClock()
+{
+    static HardwareClock hardwareClock;
+    return hardwareClock;
+}
+#endif
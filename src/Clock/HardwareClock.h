@@ -0,0 +1,13 @@
+#ifndef HARDWARE_CLOCK_H
+#define HARDWARE_CLOCK_H
+
+#include <Arduino.h>
+#include "Clock.h"
+
+class HardwareClock : public Clock
+{
+public:
+    unsigned long now() const override { return millis(); }
+};
+
+#endif
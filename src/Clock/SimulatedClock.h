@@ -0,0 +1,26 @@
+#ifndef SIMULATED_CLOCK_H
+#define SIMULATED_CLOCK_H
+
+#include "Clock.h"
+
+// Time that only moves when told to. It has no Arduino dependencies, so it also runs on a
+// host build. Start it just below the wrap to exercise rollover (unsigned long is 32 bits
+// on the ESP32, so that is the 49.7-day point there):
+//
+//   SimulatedClock simulated(~0UL - 5000);
+//   setSystemClock(simulated);
+//   simulated.advance(10000); // now() == 4999
+class SimulatedClock : public Clock
+{
+public:
+    explicit SimulatedClock(unsigned long start = 0) : current(start) {}
+    unsigned long now() const override { return current; }
+
+    void set(unsigned long ms) { current = ms; }
+    void advance(unsigned long ms) { current += ms; }
+
+private:
+    volatile unsigned long current;
+};
+
+#endif
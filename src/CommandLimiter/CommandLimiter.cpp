@@ -0,0 +1,148 @@
+#include "CommandLimiter.h"
+#include "Clock/Clock.h"
+
+CommandLimiter commandLimiter;
+
+void CommandLimiter::TokenBucket::refill(unsigned long now, float ratePerS, float burst)
+{
+    tokens += (now - lastRefill) * ratePerS / 1000.0f;
+    if (tokens > burst)
+        tokens = burst;
+    lastRefill = now;
+}
+
+unsigned long CommandLimiter::TokenBucket::millisUntilToken(float ratePerS) const
+{
+    return tokens >= 1.0f ? 0 : (unsigned long)((1.0f - tokens) * 1000.0f / ratePerS) + 1;
+}
+
+void CommandLimiter::initialize()
+{
+    unsigned long now = systemClock().now();
+    globalBucket = {GLOBAL_BURST, now};
+    for (int i = 0; i < RelayController::RELAY_COUNT; i++)
+    {
+        relayBuckets[i] = {RELAY_BURST, now};
+        switchedOnce[i] = false;
+        hasPending[i] = false;
+    }
+}
+
+bool CommandLimiter::admitMessage(unsigned long now)
+{
+    globalBucket.refill(now, GLOBAL_RATE_PER_S, GLOBAL_BURST);
+    if (globalBucket.tokens < 1.0f)
+    {
+        droppedCount++;
+        return false;
+    }
+    globalBucket.tokens -= 1.0f;
+    return true;
+}
+
+bool CommandLimiter::relayReady(int relay, unsigned long now)
+{
+    relayBuckets[relay].refill(now, RELAY_RATE_PER_S, RELAY_BURST);
+    bool intervalElapsed = !switchedOnce[relay] || now - lastSwitch[relay] >= MIN_SWITCH_INTERVAL_MS;
+    return intervalElapsed && relayBuckets[relay].tokens >= 1.0f;
+}
+
+void CommandLimiter::markApplied(int relay, unsigned long now)
+{
+    relayBuckets[relay].tokens -= 1.0f;
+    lastSwitch[relay] = now;
+    switchedOnce[relay] = true;
+    appliedCount++;
+}
+
+CommandLimiter::Result CommandLimiter::submit(const RelayCommand &command, unsigned long now, unsigned long delayMs)
+{
+    int relay = command.relay;
+    if (relay < 0 || relay >= RelayController::RELAY_COUNT)
+    {
+        droppedCount++;
+        return DROPPED;
+    }
+
+    if (delayMs == 0 && !hasPending[relay] && relayReady(relay, now))
+    {
+        markApplied(relay, now);
+        return APPLY_NOW;
+    }
+
+    // Last command wins: a newer one replaces whatever is still waiting for this relay
+    if (hasPending[relay])
+        coalescedCount++;
+    else
+        deferredCount++;
+    if (delayMs > 0)
+        staggeredCount++;
+    pending[relay] = command;
+    pending[relay].deferred = true;
+    hasPending[relay] = true;
+    pendingSince[relay] = now;
+    pendingDelay[relay] = delayMs;
+    return DEFERRED;
+}
+
+bool CommandLimiter::takeDueCommand(unsigned long now, RelayCommand &command)
+{
+    for (int i = 0; i < RelayController::RELAY_COUNT; i++)
+    {
+        if (hasPending[i] && now - pendingSince[i] >= pendingDelay[i] && relayReady(i, now))
+        {
+            command = pending[i];
+            hasPending[i] = false;
+            markApplied(i, now);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool CommandLimiter::getPendingCommand(int relay, RelayCommand &command) const
+{
+    if (relay < 0 || relay >= RelayController::RELAY_COUNT || !hasPending[relay])
+        return false;
+    command = pending[relay];
+    return true;
+}
+
+void CommandLimiter::cancelPending(int relay)
+{
+    if (relay >= 0 && relay < RelayController::RELAY_COUNT)
+        hasPending[relay] = false;
+}
+
+unsigned long CommandLimiter::getMillisUntilNextDue(unsigned long now) const
+{
+    unsigned long earliest = ULONG_MAX;
+    for (int i = 0; i < RelayController::RELAY_COUNT; i++)
+    {
+        if (!hasPending[i])
+            continue;
+
+        unsigned long wait = 0;
+        if (switchedOnce[i])
+        {
+            unsigned long elapsed = now - lastSwitch[i];
+            wait = elapsed >= MIN_SWITCH_INTERVAL_MS ? 0 : MIN_SWITCH_INTERVAL_MS - elapsed;
+        }
+        TokenBucket bucket = relayBuckets[i];
+        bucket.refill(now, RELAY_RATE_PER_S, RELAY_BURST);
+        wait = max(wait, bucket.millisUntilToken(RELAY_RATE_PER_S));
+        unsigned long held = now - pendingSince[i];
+        wait = max(wait, held >= pendingDelay[i] ? 0UL : pendingDelay[i] - held);
+        earliest = min(earliest, wait);
+    }
+    return earliest;
+}
+
+void CommandLimiter::fillMetrics(JsonObject metrics)
+{
+    metrics["applied"] = appliedCount;
+    metrics["dropped"] = droppedCount;
+    metrics["deferred"] = deferredCount;
+    metrics["coalesced"] = coalescedCount;
+    metrics["staggered"] = staggeredCount;
+}
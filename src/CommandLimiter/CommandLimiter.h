@@ -0,0 +1,70 @@
+#ifndef COMMAND_LIMITER_H
+#define COMMAND_LIMITER_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include "RelayController/RelayController.h"
+
+// Storm protection for relay commands: a global token bucket drops floods outright, while
+// per-relay buckets and a minimum switching interval defer commands instead. Deferred
+// commands coalesce per relay, so only the last command of a burst is applied.
+class CommandLimiter
+{
+public:
+    enum Result
+    {
+        APPLY_NOW,
+        DEFERRED,
+        DROPPED
+    };
+
+    void initialize();
+    // Cheap pre-check before a message is even parsed
+    bool admitMessage(unsigned long now);
+    // delayMs > 0 holds the command back at least that long (group stagger); it then
+    // goes through the normal per-relay limits and can still be replaced by a newer command
+    Result submit(const RelayCommand &command, unsigned long now, unsigned long delayMs = 0);
+    bool takeDueCommand(unsigned long now, RelayCommand &command);
+    bool getPendingCommand(int relay, RelayCommand &command) const;
+    void cancelPending(int relay);
+    unsigned long getMillisUntilNextDue(unsigned long now) const;
+    void fillMetrics(JsonObject metrics);
+
+    static constexpr float GLOBAL_RATE_PER_S = 20.0f;
+    static constexpr float GLOBAL_BURST = 40.0f;
+    static constexpr float RELAY_RATE_PER_S = 2.0f;
+    static constexpr float RELAY_BURST = 4.0f;
+    static const unsigned long MIN_SWITCH_INTERVAL_MS = 250;
+
+private:
+    struct TokenBucket
+    {
+        float tokens;
+        unsigned long lastRefill;
+
+        void refill(unsigned long now, float ratePerS, float burst);
+        unsigned long millisUntilToken(float ratePerS) const;
+    };
+
+    bool relayReady(int relay, unsigned long now);
+    void markApplied(int relay, unsigned long now);
+
+    TokenBucket globalBucket;
+    TokenBucket relayBuckets[RelayController::RELAY_COUNT];
+    unsigned long lastSwitch[RelayController::RELAY_COUNT];
+    bool switchedOnce[RelayController::RELAY_COUNT];
+    RelayCommand pending[RelayController::RELAY_COUNT];
+    bool hasPending[RelayController::RELAY_COUNT];
+    unsigned long pendingSince[RelayController::RELAY_COUNT];
+    unsigned long pendingDelay[RelayController::RELAY_COUNT];
+
+    uint32_t appliedCount = 0;
+    uint32_t droppedCount = 0;
+    uint32_t deferredCount = 0;
+    uint32_t coalescedCount = 0;
+    uint32_t staggeredCount = 0;
+};
+
+extern CommandLimiter commandLimiter; // Declaration only
+
+#endif
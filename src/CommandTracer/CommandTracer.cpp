@@ -0,0 +1,54 @@
+#include "CommandTracer.h"
+
+CommandTracer commandTracer;
+
+void TraceRecord::toJson(JsonObject trace) const
+{
+    trace["id"] = traceId;
+    trace["relay"] = relay;
+    if (sentAt)
+        trace["sentAt"] = sentAt;
+    trace["rxUs"] = receivedAt;
+    trace["decodeUs"] = decodedAt - receivedAt;
+    trace["applyUs"] = appliedAt - decodedAt;
+    trace["deferred"] = deferred;
+}
+
+TraceRecord CommandTracer::record(const RelayCommand &command, int64_t appliedAt)
+{
+    TraceRecord trace;
+    strlcpy(trace.traceId, command.traceId, sizeof(trace.traceId));
+    trace.relay = command.relay;
+    trace.action = command.action;
+    trace.sentAt = command.sentAt;
+    trace.receivedAt = command.receivedAt;
+    trace.decodedAt = command.decodedAt;
+    trace.appliedAt = appliedAt;
+    trace.deferred = command.deferred;
+
+    portENTER_CRITICAL(&traceMux);
+    ring[next] = trace;
+    next = (next + 1) % RING_SIZE;
+    if (count < RING_SIZE)
+        count++;
+    portEXIT_CRITICAL(&traceMux);
+    return trace;
+}
+
+int CommandTracer::snapshot(TraceRecord (&out)[RING_SIZE]) const
+{
+    portENTER_CRITICAL(&traceMux);
+    int copied = count;
+    for (int i = 0; i < copied; i++)
+        out[i] = ring[(next - copied + i + RING_SIZE) % RING_SIZE];
+    portEXIT_CRITICAL(&traceMux);
+    return copied;
+}
+
+void CommandTracer::fillTraces(JsonArray traces) const
+{
+    TraceRecord records[RING_SIZE];
+    int copied = snapshot(records);
+    for (int i = 0; i < copied; i++)
+        records[i].toJson(traces.add<JsonObject>());
+}
@@ -0,0 +1,44 @@
+#ifndef COMMAND_TRACER_H
+#define COMMAND_TRACER_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include "RelayController/RelayCommand.h"
+
+// Per-hop timing of a traced command, all device times in µs since boot
+struct TraceRecord
+{
+    char traceId[RelayCommand::TRACE_ID_LENGTH];
+    int relay;
+    uint8_t action;
+    uint64_t sentAt;     // Sender's timestamp, echoed unchanged
+    int64_t receivedAt;  // mqttCallback entry
+    int64_t decodedAt;   // JSON parsed and classified
+    int64_t appliedAt;   // GPIO written
+    bool deferred;       // Held back by the rate limiter before being applied
+
+    void toJson(JsonObject trace) const;
+};
+
+// Small ring of the most recent traced commands, retrievable over MQTT and HTTP.
+// Written from loop(); the web server reads it on the AsyncTCP task, so readers take a copy.
+class CommandTracer
+{
+public:
+    static const int RING_SIZE = 16;
+
+    TraceRecord record(const RelayCommand &command, int64_t appliedAt);
+    // Copies the ring oldest first; returns how many records were copied
+    int snapshot(TraceRecord (&out)[RING_SIZE]) const;
+    void fillTraces(JsonArray traces) const;
+
+private:
+    TraceRecord ring[RING_SIZE];
+    int next = 0;
+    int count = 0;
+    mutable portMUX_TYPE traceMux = portMUX_INITIALIZER_UNLOCKED;
+};
+
+extern CommandTracer commandTracer; // Declaration only
+
+#endif
@@ -0,0 +1,252 @@
+#include "ConfigManager.h"
+#include "Clock/Clock.h"
+#include "WiFiManager/WiFiManager.h"
+#include "BrokerManager/BrokerManager.h"
+#include "MQTTManager/MQTTManager.h"
+#include "SensorManager/SensorManager.h"
+#include "RuleEngine/RuleEngine.h"
+#include "PowerManager/PowerManager.h"
+#include "StatusReporter/StatusReporter.h"
+#include "GroupManager/GroupManager.h"
+#include "InputManager/InputManager.h"
+#include "WebInterface/WebInterface.h"
+
+ConfigManager configManager;
+
+void ConfigManager::initialize(PreferencesManager &prefs)
+{
+    preferences = &prefs;
+}
+
+bool ConfigManager::submit(const char *json, size_t length, const char *source)
+{
+    if (length > MAX_CONFIG_SIZE)
+        return false;
+
+    // A newer submission replaces one that has not been applied yet
+    portENTER_CRITICAL(&configMux);
+    memcpy(pending, json, length);
+    pending[length] = '\0';
+    pendingLength = length;
+    pendingSource = source;
+    submittedAt = systemClock().now();
+    hasPending = true;
+    portEXIT_CRITICAL(&configMux);
+    return true;
+}
+
+unsigned long ConfigManager::getMillisUntilDue(unsigned long now) const
+{
+    if (!hasPending)
+        return ULONG_MAX;
+    unsigned long elapsed = now - submittedAt;
+    return elapsed >= APPLY_DELAY_MS ? 0 : APPLY_DELAY_MS - elapsed;
+}
+
+void ConfigManager::loop(unsigned long now)
+{
+    if (getMillisUntilDue(now) != 0)
+        return;
+
+    char json[MAX_CONFIG_SIZE + 1];
+    portENTER_CRITICAL(&configMux);
+    memcpy(json, pending, pendingLength + 1);
+    const char *source = pendingSource;
+    hasPending = false;
+    portEXIT_CRITICAL(&configMux);
+
+    JsonDocument doc;
+    String error;
+    uint32_t changes = 0;
+    if (deserializeJson(doc, json) || !doc.is<JsonObject>())
+        error = "invalid JSON";
+    else
+        changes = apply(doc.as<JsonObjectConst>(), error);
+
+    Serial.println("⚙️ Config from " + String(source) + ": " + String(changes, HEX) +
+                   (error.length() ? " (" + error + ")" : ""));
+    if (appliedCallback)
+        appliedCallback(changes, source, error.length() ? error.c_str() : nullptr);
+}
+
+// Each setting is independent: an invalid one is reported and skipped, the rest still apply
+uint32_t ConfigManager::apply(JsonObjectConst config, String &error)
+{
+    // Before the first configuration only the preferences are written; the subsystems
+    // are started with them when the device leaves setup mode
+    bool live = preferences->isConfigured();
+    uint32_t changes = 0;
+
+    String previousSsid = preferences->getWiFiSSID();
+    String previousPassword = preferences->getWiFiPassword();
+    String ssid = config["ssid"] | previousSsid;
+    String password = config["password"] | previousPassword;
+    if (ssid != "" && (ssid != previousSsid || password != previousPassword))
+    {
+        preferences->setWiFiCredentials(ssid, password);
+        changes |= WIFI;
+    }
+
+    String username = config["username"] | preferences->getSystemUsername();
+    String userPassword = config["user_password"] | preferences->getSystemPassword();
+    if (username != preferences->getSystemUsername() || userPassword != preferences->getSystemPassword())
+    {
+        preferences->setSystemCredentials(username, userPassword);
+        // Picked up by the periodic credential check in loop()
+        webInterface.setCredentialsSent(false);
+        changes |= CREDENTIALS;
+    }
+
+    if (config["brokers"].is<JsonArrayConst>())
+    {
+        String brokers;
+        serializeJson(config["brokers"], brokers);
+        if (brokers != preferences->getBrokers())
+        {
+            if (brokerManager.setBrokers(brokers))
+            {
+                preferences->setBrokers(brokers);
+                if (live)
+                    mqttManager.requestReconnect();
+                changes |= BROKERS;
+            }
+            else
+            {
+                error += "invalid brokers; ";
+            }
+        }
+    }
+
+    unsigned long sampleMs = config["sampleMs"] | preferences->getSampleInterval();
+    unsigned long batchMs = config["batchMs"] | preferences->getTelemetryInterval();
+    if (sampleMs != preferences->getSampleInterval() || batchMs != preferences->getTelemetryInterval())
+    {
+        preferences->setSensorIntervals(sampleMs, batchMs);
+        if (live)
+            sensorManager.setIntervals(sampleMs, batchMs);
+        changes |= SENSORS;
+    }
+
+    if (config["rules"].is<JsonArrayConst>())
+    {
+        String rules;
+        serializeJson(config["rules"], rules);
+        // Sending the same rules again is how an operator resumes them after an all-off
+        if (rules != preferences->getRules() || ruleEngine.isSuspended())
+        {
+            if (ruleEngine.loadRules(rules))
+            {
+                preferences->setRules(rules);
+                changes |= RULES;
+            }
+            else
+            {
+                error += "invalid rules; ";
+            }
+        }
+    }
+
+    if (config["lightSleep"].is<bool>())
+    {
+        bool lightSleep = config["lightSleep"];
+        if (lightSleep != preferences->getLightSleepEnabled())
+        {
+            preferences->setLightSleepEnabled(lightSleep);
+            if (live)
+                powerManager.setLightSleep(lightSleep);
+            changes |= POWER;
+        }
+    }
+
+    unsigned long heartbeatMs = config["heartbeatMs"] | preferences->getHeartbeatInterval();
+    if (heartbeatMs != preferences->getHeartbeatInterval())
+    {
+        if (heartbeatMs >= MIN_HEARTBEAT_MS && heartbeatMs <= MAX_HEARTBEAT_MS)
+        {
+            preferences->setHeartbeatInterval(heartbeatMs);
+            statusReporter.setHeartbeatInterval(heartbeatMs);
+            changes |= STATUS;
+        }
+        else
+        {
+            error += "heartbeatMs out of range; ";
+        }
+    }
+
+    if (config["groups"].is<JsonArrayConst>())
+    {
+        String groups;
+        serializeJson(config["groups"], groups);
+        if (groups != preferences->getGroups())
+        {
+            mqttManager.unsubscribeGroups();
+            if (groupManager.setGroups(groups))
+            {
+                preferences->setGroups(groups);
+                changes |= GROUPS;
+            }
+            else
+            {
+                error += "invalid groups; ";
+            }
+            mqttManager.subscribeGroups();
+        }
+    }
+
+    if (config["inputs"].is<JsonArrayConst>())
+    {
+        String inputs;
+        serializeJson(config["inputs"], inputs);
+        if (inputs != preferences->getInputs())
+        {
+            if (inputManager.setInputs(inputs))
+            {
+                preferences->setInputs(inputs);
+                changes |= INPUTS;
+            }
+            else
+            {
+                error += "invalid inputs; ";
+            }
+        }
+    }
+
+    // Last, so every other setting is stored before the link drops. A network that does not
+    // associate is rolled back to the previous one, which keeps the device reachable.
+    if (changes & WIFI)
+    {
+        if (live)
+            wifiManager.reconnect(previousSsid, previousPassword);
+        else
+            preferences->setConfigured(true);
+    }
+
+    return changes;
+}
+
+void ConfigManager::fillConfig(JsonObject config) const
+{
+    config["ssid"] = preferences->getWiFiSSID();
+    config["username"] = preferences->getSystemUsername();
+    // Stored lists were validated on the way in; embed them without a parse
+    String brokers = preferences->getBrokers();
+    if (brokers.length() > 0)
+        config["brokers"] = serialized(brokers);
+    config["sampleMs"] = preferences->getSampleInterval();
+    config["batchMs"] = preferences->getTelemetryInterval();
+    config["rules"] = serialized(preferences->getRules());
+    config["lightSleep"] = preferences->getLightSleepEnabled();
+    config["heartbeatMs"] = preferences->getHeartbeatInterval();
+    config["groups"] = serialized(preferences->getGroups());
+    config["inputs"] = serialized(preferences->getInputs());
+}
+
+void ConfigManager::fillChangeNames(uint32_t changes, JsonArray names)
+{
+    static const char *NAMES[] = {"wifi", "credentials", "brokers", "sensors", "rules", "power", "status", "groups", "inputs"};
+    for (int i = 0; i < (int)(sizeof(NAMES) / sizeof(NAMES[0])); i++)
+    {
+        if (changes & (1UL << i))
+            names.add(NAMES[i]);
+    }
+}
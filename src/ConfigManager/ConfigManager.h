@@ -0,0 +1,70 @@
+#ifndef CONFIG_MANAGER_H
+#define CONFIG_MANAGER_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include "PreferencesManager/PreferencesManager.h"
+
+// Applies configuration changes without a reboot. A submitted config is diffed against the
+// stored settings; only changed settings are persisted and only the subsystems they belong
+// to are restarted. Relay outputs and timers are never touched.
+//
+// Accepted keys, all optional: ssid, password, username, user_password, brokers (see
+// BrokerManager), sampleMs, batchMs, rules (see RuleEngine), lightSleep, heartbeatMs,
+// groups (see GroupManager), inputs (see InputManager).
+class ConfigManager
+{
+public:
+    enum Change : uint32_t
+    {
+        WIFI = 1 << 0,
+        CREDENTIALS = 1 << 1,
+        BROKERS = 1 << 2,
+        SENSORS = 1 << 3,
+        RULES = 1 << 4,
+        POWER = 1 << 5,
+        STATUS = 1 << 6,
+        GROUPS = 1 << 7,
+        INPUTS = 1 << 8
+    };
+
+    void initialize(PreferencesManager &prefs);
+    // Safe to call from any task (HTTP handlers run on the AsyncTCP task). The config is
+    // applied from loop() once APPLY_DELAY_MS has passed, so an HTTP reply can leave
+    // before WiFi is reconfigured. Returns false if the config is too large.
+    bool submit(const char *json, size_t length, const char *source);
+    // Applies a pending config; call from loop()
+    void loop(unsigned long now);
+    unsigned long getMillisUntilDue(unsigned long now) const;
+
+    // Called after every apply with the changed settings, or with an error
+    void setAppliedCallback(void (*callback)(uint32_t changes, const char *source, const char *error))
+    {
+        appliedCallback = callback;
+    }
+    static void fillChangeNames(uint32_t changes, JsonArray names);
+    // Current settings in the shape submit() accepts, passwords left out
+    void fillConfig(JsonObject config) const;
+
+    static const size_t MAX_CONFIG_SIZE = 1024;
+    static const unsigned long APPLY_DELAY_MS = 500;
+    static const unsigned long MIN_HEARTBEAT_MS = 10000;
+    static const unsigned long MAX_HEARTBEAT_MS = 3600000; // Metrics windows follow the heartbeat
+
+private:
+    uint32_t apply(JsonObjectConst config, String &error);
+
+    PreferencesManager *preferences = nullptr;
+    void (*appliedCallback)(uint32_t, const char *, const char *) = nullptr;
+
+    portMUX_TYPE configMux = portMUX_INITIALIZER_UNLOCKED;
+    char pending[MAX_CONFIG_SIZE + 1];
+    size_t pendingLength = 0;
+    const char *pendingSource = "";
+    volatile bool hasPending = false;
+    unsigned long submittedAt = 0;
+};
+
+extern ConfigManager configManager; // Declaration only
+
+#endif
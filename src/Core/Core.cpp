@@ -1,17 +1,18 @@
 #include "Core.h"
+#include <esp_system.h>
 
 Core core;
 
 void Core::initialize()
 {
     Serial.begin(115200);
-    delay(1000);
+    markBootPhase("serial");
 
     Serial.println("\n🌱 GreenTech Relay Controller Starting...");
     Serial.println("==========================================");
 
     generateDeviceId();
-    deviceStartTime = millis();
+    deviceStartTime = systemClock().now();
 }
 
 void Core::generateDeviceId()
@@ -19,4 +20,51 @@ void Core::generateDeviceId()
     deviceId = "GT-" + String((uint32_t)ESP.getEfuseMac(), HEX);
     Serial.print("📟 Device ID: ");
     Serial.println(deviceId);
+}
+
+void Core::markBootPhase(const char *name)
+{
+    if (bootPhaseCount < MAX_BOOT_PHASES)
+    {
+        bootPhases[bootPhaseCount].name = name;
+        bootPhases[bootPhaseCount].at = millis();
+        bootPhaseCount++;
+    }
+}
+
+void Core::printBootProfile() const
+{
+    Serial.println("⏱️ Boot profile (" + String(getResetReason()) + "):");
+    unsigned long previous = 0;
+    for (int i = 0; i < bootPhaseCount; i++)
+    {
+        Serial.println("   " + String(bootPhases[i].name) + ": " + String(bootPhases[i].at) +
+                       " ms (+" + String(bootPhases[i].at - previous) + ")");
+        previous = bootPhases[i].at;
+    }
+}
+
+const char *Core::getResetReason() const
+{
+    switch (esp_reset_reason())
+    {
+    case ESP_RST_POWERON:
+        return "power-on";
+    case ESP_RST_BROWNOUT:
+        return "brownout";
+    case ESP_RST_SW:
+        return "software";
+    case ESP_RST_PANIC:
+        return "panic";
+    case ESP_RST_INT_WDT:
+    case ESP_RST_TASK_WDT:
+    case ESP_RST_WDT:
+        return "watchdog";
+    case ESP_RST_DEEPSLEEP:
+        return "deep-sleep";
+    case ESP_RST_EXT:
+        return "external";
+    default:
+        return "unknown";
+    }
 }
\ No newline at end of file
@@ -2,13 +2,29 @@
 #define CORE_H
 
 #include <Arduino.h>
+#include "Clock/Clock.h"
+
+struct BootPhase
+{
+    const char *name;
+    unsigned long at; // ms since power-on
+};
 
 class Core
 {
 public:
     void initialize();
+
+    // Boot profiling: timestamps each phase from power-on until the first MQTT connection
+    void markBootPhase(const char *name);
+    const BootPhase *getBootPhases() const { return bootPhases; }
+    int getBootPhaseCount() const { return bootPhaseCount; }
+    void printBootProfile() const;
+    const char *getResetReason() const;
+
+    static const int MAX_BOOT_PHASES = 12;
     String getDeviceId() const { return deviceId; }
-    unsigned long getUptime() const { return millis() - deviceStartTime; }
+    unsigned long getUptime() const { return systemClock().now() - deviceStartTime; }
     bool isDeviceConfigured() const { return isConfigured; }
     void setDeviceConfigured(bool configured) { isConfigured = configured; }
 
@@ -18,6 +34,8 @@ private:
     String deviceId;
     unsigned long deviceStartTime = 0;
     bool isConfigured = false;
+    BootPhase bootPhases[MAX_BOOT_PHASES];
+    int bootPhaseCount = 0;
 };
 
 extern Core core; // Declaration only
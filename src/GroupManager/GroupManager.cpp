@@ -0,0 +1,109 @@
+#include "GroupManager.h"
+
+GroupManager groupManager;
+
+static const char *GROUP_TOPIC_PREFIX = "green-tech/group/";
+static const char *GROUP_TOPIC_SUFFIX = "/relay-control";
+
+void GroupManager::initialize(PreferencesManager &prefs, const String &id)
+{
+    preferences = &prefs;
+    deviceId = id;
+
+    // FNV-1a: stable across reboots and firmware versions, so a device keeps its slot
+    staggerHash = 2166136261UL;
+    for (size_t i = 0; i < deviceId.length(); i++)
+    {
+        staggerHash ^= (uint8_t)deviceId[i];
+        staggerHash *= 16777619UL;
+    }
+
+    setGroups(preferences->getGroups());
+}
+
+bool GroupManager::isValidName(const String &name)
+{
+    if (name.length() == 0 || name.length() > MAX_NAME_LENGTH)
+        return false;
+    for (size_t i = 0; i < name.length(); i++)
+    {
+        char c = name[i];
+        if (!isalnum(c) && c != '-' && c != '_')
+            return false;
+    }
+    return true;
+}
+
+bool GroupManager::setGroups(const String &json)
+{
+    JsonDocument doc;
+    if (deserializeJson(doc, json) || !doc.is<JsonArray>())
+        return false;
+
+    String parsed[MAX_GROUPS];
+    int count = 0;
+    for (JsonVariant item : doc.as<JsonArray>())
+    {
+        String name = item | "";
+        if (!isValidName(name) || count >= MAX_GROUPS)
+            return false;
+        parsed[count++] = name;
+    }
+
+    for (int i = 0; i < count; i++)
+        groups[i] = parsed[i];
+    groupCount = count;
+
+    Serial.println("👥 Member of " + String(groupCount) + " group(s)");
+    return true;
+}
+
+String GroupManager::getTopic(int index) const
+{
+    return String(GROUP_TOPIC_PREFIX) + groups[index] + GROUP_TOPIC_SUFFIX;
+}
+
+int GroupManager::matchTopic(const char *topic) const
+{
+    size_t prefixLength = strlen(GROUP_TOPIC_PREFIX);
+    if (strncmp(topic, GROUP_TOPIC_PREFIX, prefixLength) != 0)
+        return -1;
+
+    const char *name = topic + prefixLength;
+    const char *slash = strchr(name, '/');
+    if (!slash || strcmp(slash, GROUP_TOPIC_SUFFIX) != 0)
+        return -1;
+
+    size_t nameLength = slash - name;
+    for (int i = 0; i < groupCount; i++)
+    {
+        if (groups[i].length() == nameLength && strncmp(groups[i].c_str(), name, nameLength) == 0)
+            return i;
+    }
+    return -1;
+}
+
+unsigned long GroupManager::getStaggerDelay(const JsonDocument &doc) const
+{
+    unsigned long delayMs = 0;
+    JsonVariantConst explicitDelay = doc["stagger"][deviceId];
+    if (!explicitDelay.isNull())
+    {
+        delayMs = explicitDelay.as<unsigned long>();
+    }
+    else
+    {
+        unsigned long window = doc["staggerMs"] | 0UL;
+        if (window > MAX_STAGGER_MS)
+            window = MAX_STAGGER_MS;
+        if (window > 0)
+            delayMs = staggerHash % (window + 1);
+    }
+    return delayMs > MAX_STAGGER_MS ? MAX_STAGGER_MS : delayMs;
+}
+
+void GroupManager::fillGroups(JsonArray names) const
+{
+    for (int i = 0; i < groupCount; i++)
+        names.add(groups[i]);
+}
@@ -0,0 +1,43 @@
+#ifndef GROUP_MANAGER_H
+#define GROUP_MANAGER_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include "PreferencesManager/PreferencesManager.h"
+
+// Group (zone) membership for multicast commands. Each group maps to one topic,
+// green-tech/group/<name>/relay-control, so a single publish reaches every member through
+// the broker's fan-out. Membership lives in NVS and is changed through ConfigManager.
+class GroupManager
+{
+public:
+    void initialize(PreferencesManager &prefs, const String &deviceId);
+    // Expects ["zone-a", "greenhouse-3", ...]; names use letters, digits, '-' and '_'
+    bool setGroups(const String &json);
+    int getGroupCount() const { return groupCount; }
+    String getTopic(int index) const;
+    // Returns the group index if the topic belongs to one of our groups, otherwise -1
+    int matchTopic(const char *topic) const;
+
+    // Per-device delay for a group command: an explicit entry in "stagger" ({"<deviceId>": ms})
+    // wins, otherwise a stable hash of the device id spreads members over "staggerMs"
+    unsigned long getStaggerDelay(const JsonDocument &doc) const;
+    void fillGroups(JsonArray names) const;
+
+    static const int MAX_GROUPS = 8;
+    static const int MAX_NAME_LENGTH = 24;
+    static const unsigned long MAX_STAGGER_MS = 600000;
+
+private:
+    static bool isValidName(const String &name);
+
+    PreferencesManager *preferences = nullptr;
+    String deviceId;
+    String groups[MAX_GROUPS];
+    int groupCount = 0;
+    uint32_t staggerHash = 0;
+};
+
+extern GroupManager groupManager; // Declaration only
+
+#endif
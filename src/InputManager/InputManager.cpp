@@ -0,0 +1,208 @@
+#include "InputManager.h"
+#include "SensorManager/AdcSampleSource.h"
+#include <soc/gpio_reg.h>
+
+InputManager inputManager;
+
+void InputManager::initialize(RelayController &relays, PreferencesManager &prefs)
+{
+    relayController = &relays;
+    preferences = &prefs;
+
+    queue = xQueueCreate(QUEUE_LENGTH, sizeof(InputEvent));
+    // Above every application task, so a button press preempts loop(), MQTT and the web server
+    xTaskCreatePinnedToCore(taskEntry, "inputs", 3072, this, configMAX_PRIORITIES - 3, &task, tskNO_AFFINITY);
+
+    if (!setInputs(preferences->getInputs()))
+        Serial.println("⚠️ Stored input configuration is invalid, inputs disabled");
+}
+
+bool InputManager::setInputs(const String &json)
+{
+    JsonDocument doc;
+    if (deserializeJson(doc, json) || !doc.is<JsonArray>())
+        return false;
+
+    Input parsed[MAX_INPUTS];
+    int count = 0;
+    for (JsonObject item : doc.as<JsonArray>())
+    {
+        int pin = item["pin"] | -1;
+        int relay = item["relay"] | -1;
+        String mode = item["mode"] | "momentary";
+        // Flash pins, relay outputs and sensor inputs cannot double as inputs
+        if (count >= MAX_INPUTS || !GPIO_IS_VALID_GPIO(pin) || (pin >= 6 && pin <= 11) ||
+            relayController->usesPin(pin) || AdcSampleSource::usesPin(pin) || relay < 0 ||
+            relay >= RelayController::RELAY_COUNT || (mode != "momentary" && mode != "latching"))
+            return false;
+        // Without a pull resistor the pin floats and every stray edge switches the relay
+        bool externalPull = item["externalPull"] | false;
+        if (!hasInternalPull(pin) && !externalPull)
+        {
+            Serial.println("⚠️ GPIO " + String(pin) + " has no internal pull resistor; wire one and set externalPull");
+            return false;
+        }
+
+        Input &input = parsed[count];
+        input.owner = this;
+        input.index = count;
+        input.pin = pin;
+        input.relay = relay;
+        input.mode = mode == "latching" ? LATCHING : MOMENTARY;
+        input.activeLow = item["activeLow"] | true;
+        input.lastEdgeUs = 0;
+        count++;
+    }
+
+    detachAll();
+    for (int i = 0; i < count; i++)
+    {
+        if (!hasInternalPull(parsed[i].pin))
+            pinMode(parsed[i].pin, INPUT);
+        else
+            pinMode(parsed[i].pin, parsed[i].activeLow ? INPUT_PULLUP : INPUT_PULLDOWN);
+        // Start from the current level so a switch already closed does not fire at boot
+        parsed[i].active = readActive(parsed[i]);
+    }
+
+    portENTER_CRITICAL(&inputMux);
+    for (int i = 0; i < count; i++)
+        inputs[i] = parsed[i];
+    inputCount = count;
+    portEXIT_CRITICAL(&inputMux);
+    // Edges queued for the old table must not be applied to the new one
+    xQueueReset(queue);
+
+    for (int i = 0; i < inputCount; i++)
+        attachInterruptArg(digitalPinToInterrupt(inputs[i].pin), onEdge, &inputs[i], CHANGE);
+
+    Serial.println("🔘 " + String(inputCount) + " manual input(s) configured");
+    return true;
+}
+
+void InputManager::detachAll()
+{
+    for (int i = 0; i < inputCount; i++)
+        detachInterrupt(digitalPinToInterrupt(inputs[i].pin));
+}
+
+// Direct register read: gpio_get_level() is not guaranteed to be in IRAM
+bool IRAM_ATTR InputManager::readActive(const Input &input)
+{
+    uint32_t level = input.pin < 32 ? (REG_READ(GPIO_IN_REG) >> input.pin) & 1
+                                    : (REG_READ(GPIO_IN1_REG) >> (input.pin - 32)) & 1;
+    return input.activeLow ? level == 0 : level == 1;
+}
+
+// Leading-edge debounce: the first edge acts immediately, bounces inside the window are
+// dropped, and the task re-reads the pin once the window closes
+void IRAM_ATTR InputManager::onEdge(void *arg)
+{
+    Input *input = static_cast<Input *>(arg);
+    InputManager *owner = input->owner;
+    int64_t now = esp_timer_get_time();
+    if (now - input->lastEdgeUs < DEBOUNCE_US)
+    {
+        owner->bounceCount++;
+        return;
+    }
+    input->lastEdgeUs = now;
+
+    InputEvent event = {input->index, readActive(*input), now};
+    BaseType_t woken = pdFALSE;
+    xQueueSendFromISR(owner->queue, &event, &woken);
+    if (woken)
+        portYIELD_FROM_ISR();
+}
+
+void InputManager::taskEntry(void *arg)
+{
+    static_cast<InputManager *>(arg)->run();
+}
+
+void InputManager::run()
+{
+    bool settlePending = false;
+    while (true)
+    {
+        InputEvent event;
+        TickType_t timeout = settlePending ? pdMS_TO_TICKS(DEBOUNCE_US / 1000) + 1 : portMAX_DELAY;
+        if (xQueueReceive(queue, &event, timeout) == pdTRUE)
+        {
+            handle(event);
+            settlePending = true;
+            continue;
+        }
+
+        // The debounce window has closed: catch a contact that settled opposite to its last edge
+        settlePending = false;
+        for (int i = 0; i < inputCount; i++)
+        {
+            InputEvent settled = {(uint8_t)i, readActive(inputs[i]), esp_timer_get_time()};
+            handle(settled);
+        }
+    }
+}
+
+// Runs on the input task; RelayController serializes against loop() and the pulse timers
+void InputManager::handle(const InputEvent &event)
+{
+    portENTER_CRITICAL(&inputMux);
+    bool valid = event.index < inputCount && inputs[event.index].active != event.active;
+    Input input = inputs[event.index < MAX_INPUTS ? event.index : 0];
+    if (valid)
+        inputs[event.index].active = event.active;
+    portEXIT_CRITICAL(&inputMux);
+    if (!valid)
+        return;
+
+    bool state;
+    if (input.mode == MOMENTARY)
+        state = event.active;
+    else if (event.active)
+        state = !relayController->getRelayState(input.relay);
+    else
+        return; // Latching inputs act on activation only
+
+    relayController->forceRelay(input.relay, state);
+
+    uint32_t latency = (uint32_t)(relayController->getLastOutputTime(input.relay) - event.at);
+    portENTER_CRITICAL(&inputMux);
+    overriddenMask |= (1UL << input.relay);
+    eventCount++;
+    if (latency > latencyMaxUs)
+        latencyMaxUs = latency;
+    portEXIT_CRITICAL(&inputMux);
+}
+
+uint32_t InputManager::takeOverriddenMask()
+{
+    portENTER_CRITICAL(&inputMux);
+    uint32_t mask = overriddenMask;
+    overriddenMask = 0;
+    portEXIT_CRITICAL(&inputMux);
+    return mask;
+}
+
+void InputManager::fillMetrics(JsonObject metrics)
+{
+    portENTER_CRITICAL(&inputMux);
+    uint32_t events = eventCount;
+    uint32_t bounces = bounceCount;
+    uint32_t maxUs = latencyMaxUs;
+    portEXIT_CRITICAL(&inputMux);
+
+    metrics["inputs"] = inputCount;
+    metrics["events"] = events;
+    metrics["bounces"] = bounces;
+    metrics["latencyMaxUs"] = maxUs;
+}
+
+void InputManager::resetMetrics()
+{
+    portENTER_CRITICAL(&inputMux);
+    eventCount = 0;
+    bounceCount = 0;
+    latencyMaxUs = 0;
+    portEXIT_CRITICAL(&inputMux);
+}
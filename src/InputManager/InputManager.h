@@ -0,0 +1,87 @@
+#ifndef INPUT_MANAGER_H
+#define INPUT_MANAGER_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <freertos/queue.h>
+#include "RelayController/RelayController.h"
+#include "PreferencesManager/PreferencesManager.h"
+
+// Manual override buttons and switches. Edges are timestamped in a GPIO interrupt, debounced
+// there and queued to a high-priority task that switches the relay right away, so overrides
+// work with the network down and never wait for loop(). loop() only reports what changed.
+//
+// Configured as a JSON array: [{"pin": 0, "relay": 3, "mode": "momentary", "activeLow": true}]
+//   momentary: the relay is on while the input is active
+//   latching:  each activation toggles the relay
+//   externalPull: required on GPIO 34-39, which need a resistor on the board
+class InputManager
+{
+public:
+    enum Mode : uint8_t
+    {
+        MOMENTARY,
+        LATCHING
+    };
+
+    void initialize(RelayController &relays, PreferencesManager &prefs);
+    // Call from loop(); interrupts are detached while the table is replaced
+    bool setInputs(const String &json);
+    int getInputCount() const { return inputCount; }
+
+    // Relays switched by an input since the previous call
+    uint32_t takeOverriddenMask();
+    // Counters cover the window since the last resetMetrics(); filling does not reset
+    void fillMetrics(JsonObject metrics);
+    void resetMetrics();
+
+    static const int MAX_INPUTS = 8;
+    static const int64_t DEBOUNCE_US = 20000;
+    static const int QUEUE_LENGTH = 16;
+
+private:
+    struct Input
+    {
+        InputManager *owner;
+        uint8_t index;
+        uint8_t pin;
+        uint8_t relay;
+        Mode mode;
+        bool activeLow;
+        bool active;               // Debounced state, task side only
+        volatile int64_t lastEdgeUs; // ISR side only
+    };
+
+    struct InputEvent
+    {
+        uint8_t index;
+        bool active;
+        int64_t at; // esp_timer_get_time() of the edge
+    };
+
+    static void IRAM_ATTR onEdge(void *arg);
+    static bool IRAM_ATTR readActive(const Input &input);
+    static void taskEntry(void *arg);
+    // GPIO 34-39 are input-only and have neither pull-up nor pull-down
+    static bool hasInternalPull(int pin) { return pin < 34 || pin > 39; }
+    void run();
+    void handle(const InputEvent &event);
+    void detachAll();
+
+    RelayController *relayController = nullptr;
+    PreferencesManager *preferences = nullptr;
+    Input inputs[MAX_INPUTS];
+    int inputCount = 0;
+    QueueHandle_t queue = nullptr;
+    TaskHandle_t task = nullptr;
+
+    portMUX_TYPE inputMux = portMUX_INITIALIZER_UNLOCKED;
+    volatile uint32_t overriddenMask = 0;
+    volatile uint32_t eventCount = 0;
+    volatile uint32_t bounceCount = 0;
+    volatile uint32_t latencyMaxUs = 0;
+};
+
+extern InputManager inputManager; // Declaration only
+
+#endif
@@ -0,0 +1,225 @@
+#include "LoopWatchdog.h"
+#include <esp_task_wdt.h>
+#include <esp_attr.h>
+
+LoopWatchdog loopWatchdog;
+
+// Lives in RTC slow memory, which keeps its contents across software, panic and watchdog
+// resets; a power cycle leaves garbage, caught by the magic and checksum
+struct StallLog
+{
+    uint32_t magic;
+    uint16_t bootCount;
+    uint8_t recordCount;
+    uint8_t openSection; // Section over budget right now; NONE when the loop is healthy
+    uint32_t openDurationMs;
+    uint32_t openEnteredAt;
+    LoopWatchdog::StallRecord records[LoopWatchdog::MAX_RECORDS];
+    uint32_t checksum;
+};
+
+RTC_NOINIT_ATTR static StallLog stallLog;
+
+static const uint32_t STALL_LOG_MAGIC = 0x57444C47; // "WDLG"
+
+static const char *SECTION_NAMES[LoopWatchdog::SECTION_COUNT] = {
+    "none", "setup-mode", "wifi-connect", "mqtt-connect", "mqtt-loop", "config", "relays",
+    "commands", "history", "sensors", "status", "ota", "credentials", "idle"};
+
+// Budgets in ms: the longest a healthy pass spends in each section. WiFi joins run in the
+// background, so a WiFi or config step only starts or drops a join, switches the portal or
+// writes NVS. Idle is bounded by PowerManager::MAX_IDLE_WAIT_MS.
+static const uint32_t SECTION_BUDGET_MS[LoopWatchdog::SECTION_COUNT] = {
+    UINT32_MAX, 100, 500, 5000, 250, 500, 50, 50, 100, 100, 250, 1000, 5000, 1500};
+
+static uint32_t computeChecksum(const StallLog &log)
+{
+    const uint8_t *bytes = (const uint8_t *)&log;
+    uint32_t hash = 2166136261UL;
+    for (size_t i = 0; i < offsetof(StallLog, checksum); i++)
+    {
+        hash ^= bytes[i];
+        hash *= 16777619UL;
+    }
+    return hash;
+}
+
+void LoopWatchdog::initialize()
+{
+    if (stallLog.magic != STALL_LOG_MAGIC || stallLog.checksum != computeChecksum(stallLog) ||
+        stallLog.recordCount > MAX_RECORDS || stallLog.openSection >= SECTION_COUNT)
+    {
+        memset(&stallLog, 0, sizeof(stallLog));
+        stallLog.magic = STALL_LOG_MAGIC;
+    }
+    stallLog.bootCount++;
+
+    // The previous boot reset in the middle of a stall: that section is the likely culprit
+    if (stallLog.openSection != NONE)
+    {
+        Serial.println("🐢 Previous boot reset during " + String(getSectionName(stallLog.openSection)) +
+                       " after " + String(stallLog.openDurationMs) + " ms");
+        StallRecord fatal = {stallLog.openSection, true, (uint16_t)(stallLog.bootCount - 1),
+                             stallLog.openDurationMs, stallLog.openEnteredAt / 1000};
+        recordStall(fatal);
+    }
+    stallLog.checksum = computeChecksum(stallLog);
+
+#if ESP_IDF_VERSION_MAJOR >= 5
+    esp_task_wdt_config_t wdtConfig = {};
+    wdtConfig.timeout_ms = TASK_WDT_TIMEOUT_S * 1000;
+    wdtConfig.idle_core_mask = 1 << 0;
+    wdtConfig.trigger_panic = true;
+    esp_task_wdt_reconfigure(&wdtConfig);
+#else
+    esp_task_wdt_init(TASK_WDT_TIMEOUT_S, true);
+#endif
+    // setup() runs on the loop task, so this subscribes loop()
+    esp_task_wdt_add(NULL);
+
+    esp_timer_create_args_t timerArgs = {};
+    timerArgs.callback = monitorCallback;
+    timerArgs.arg = this;
+    timerArgs.dispatch_method = ESP_TIMER_TASK;
+    timerArgs.name = "loop-watchdog";
+    esp_timer_create(&timerArgs, &monitorTimer);
+    esp_timer_start_periodic(monitorTimer, MONITOR_PERIOD_US);
+
+    Serial.println("🐕 Loop watchdog armed (boot " + String(stallLog.bootCount) + ", " +
+                   String(stallLog.recordCount) + " stall(s) on record)");
+}
+
+void LoopWatchdog::beginPass()
+{
+    unsigned long now = millis();
+    if (passStartedAt != 0 && now - passStartedAt > longestPassMs)
+        longestPassMs = now - passStartedAt;
+    passStartedAt = now;
+    enter(NONE);
+}
+
+void LoopWatchdog::enter(Section section)
+{
+    uint32_t now = millis();
+    uint8_t previous = currentSection;
+    uint32_t elapsed = now - enteredAt;
+
+    portENTER_CRITICAL(&watchdogMux);
+    currentSection = section;
+    enteredAt = now;
+    portEXIT_CRITICAL(&watchdogMux);
+    esp_task_wdt_reset();
+
+    if (previous != NONE && elapsed > SECTION_BUDGET_MS[previous])
+    {
+        Serial.println("🐢 Loop stall: " + String(getSectionName(previous)) + " took " + String(elapsed) +
+                       " ms (budget " + String(SECTION_BUDGET_MS[previous]) + ")");
+        StallRecord record = {previous, false, stallLog.bootCount, elapsed, (now - elapsed) / 1000};
+        recordStall(record);
+        stallsThisBoot++;
+    }
+}
+
+void LoopWatchdog::monitorCallback(void *arg)
+{
+    static_cast<LoopWatchdog *>(arg)->checkOpenSection();
+}
+
+// Runs in the esp_timer task: keeps the RTC copy of an ongoing stall current, so a reset
+// triggered by the stall still leaves a record of where the loop was stuck
+void LoopWatchdog::checkOpenSection()
+{
+    portENTER_CRITICAL(&watchdogMux);
+    uint8_t section = currentSection;
+    uint32_t elapsed = millis() - enteredAt;
+    bool overBudget = section != NONE && elapsed > SECTION_BUDGET_MS[section];
+    if (overBudget || stallLog.openSection != NONE)
+    {
+        stallLog.openSection = overBudget ? section : NONE;
+        stallLog.openDurationMs = overBudget ? elapsed : 0;
+        stallLog.openEnteredAt = enteredAt;
+        stallLog.checksum = computeChecksum(stallLog);
+    }
+    portEXIT_CRITICAL(&watchdogMux);
+}
+
+// Keeps the MAX_RECORDS worst stalls; stalls that ended in a reset rank above the rest
+void LoopWatchdog::recordStall(const StallRecord &record)
+{
+    portENTER_CRITICAL(&watchdogMux);
+    int slot = stallLog.recordCount;
+    if (slot >= MAX_RECORDS)
+    {
+        slot = 0;
+        for (int i = 1; i < MAX_RECORDS; i++)
+        {
+            const StallRecord &candidate = stallLog.records[i];
+            const StallRecord &weakest = stallLog.records[slot];
+            if (candidate.fatal < weakest.fatal ||
+                (candidate.fatal == weakest.fatal && candidate.durationMs < weakest.durationMs))
+                slot = i;
+        }
+        const StallRecord &weakest = stallLog.records[slot];
+        if (weakest.fatal > record.fatal ||
+            (weakest.fatal == record.fatal && weakest.durationMs >= record.durationMs))
+            slot = -1;
+    }
+    else
+    {
+        stallLog.recordCount++;
+    }
+    if (slot >= 0)
+        stallLog.records[slot] = record;
+    // The stall is over (or carried over from the last boot), so it is no longer open
+    stallLog.openSection = NONE;
+    stallLog.checksum = computeChecksum(stallLog);
+    portEXIT_CRITICAL(&watchdogMux);
+}
+
+bool LoopWatchdog::hasReport() const
+{
+    return stallLog.recordCount > 0;
+}
+
+void LoopWatchdog::fillReport(JsonDocument &doc) const
+{
+    doc["bootCount"] = stallLog.bootCount;
+    JsonArray stalls = doc["stalls"].to<JsonArray>();
+    for (int i = 0; i < stallLog.recordCount; i++)
+    {
+        const StallRecord &record = stallLog.records[i];
+        JsonObject stall = stalls.add<JsonObject>();
+        stall["section"] = getSectionName(record.section);
+        stall["durationMs"] = record.durationMs;
+        stall["budgetMs"] = SECTION_BUDGET_MS[record.section];
+        stall["boot"] = record.bootCount;
+        stall["uptimeS"] = record.uptimeS;
+        if (record.fatal)
+            stall["fatal"] = true;
+    }
+}
+
+void LoopWatchdog::clearReport()
+{
+    portENTER_CRITICAL(&watchdogMux);
+    stallLog.recordCount = 0;
+    stallLog.checksum = computeChecksum(stallLog);
+    portEXIT_CRITICAL(&watchdogMux);
+}
+
+void LoopWatchdog::fillMetrics(JsonObject metrics)
+{
+    metrics["longestPassMs"] = longestPassMs;
+    metrics["stalls"] = stallsThisBoot;
+    metrics["boot"] = stallLog.bootCount;
+}
+
+void LoopWatchdog::resetMetrics()
+{
+    longestPassMs = 0;
+}
+
+const char *LoopWatchdog::getSectionName(uint8_t section)
+{
+    return section < SECTION_COUNT ? SECTION_NAMES[section] : "unknown";
+}
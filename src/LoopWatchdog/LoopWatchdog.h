@@ -0,0 +1,79 @@
+#ifndef LOOP_WATCHDOG_H
+#define LOOP_WATCHDOG_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <esp_timer.h>
+
+// Software watchdog for loop(). loop() marks which subsystem it is in; any section that
+// runs past its budget is recorded with its duration. The worst offenders are kept in RTC
+// memory, so a stall that ends in a watchdog reset is still reported after the reboot.
+// The loop task is also registered with the ESP task watchdog as a last resort.
+class LoopWatchdog
+{
+public:
+    enum Section : uint8_t
+    {
+        NONE,
+        SETUP_MODE,
+        WIFI_CONNECT,
+        MQTT_CONNECT,
+        MQTT_LOOP,
+        CONFIG,
+        RELAYS,
+        COMMANDS,
+        HISTORY,
+        SENSORS,
+        STATUS,
+        OTA,
+        CREDENTIALS,
+        IDLE,
+        SECTION_COUNT
+    };
+
+    struct StallRecord
+    {
+        uint8_t section;
+        bool fatal;          // Still running when the device reset
+        uint16_t bootCount;  // Boot the stall happened in
+        uint32_t durationMs;
+        uint32_t uptimeS;    // When the section was entered
+    };
+
+    void initialize();
+    // Called at the top of every loop() pass; feeds the task watchdog
+    void beginPass();
+    // Leaves the current section and enters the next one
+    void enter(Section section);
+
+    // Stalls recorded since the last report, including ones from before the last reset
+    bool hasReport() const;
+    void fillReport(JsonDocument &doc) const;
+    void clearReport();
+    // longestPassMs covers the window since the last resetMetrics()
+    void fillMetrics(JsonObject metrics);
+    void resetMetrics();
+
+    static const char *getSectionName(uint8_t section);
+
+    static const int MAX_RECORDS = 8;
+    static const uint32_t TASK_WDT_TIMEOUT_S = 30; // Well above the longest legitimate block (broker connect)
+    static const uint64_t MONITOR_PERIOD_US = 250000;
+
+private:
+    static void monitorCallback(void *arg);
+    void checkOpenSection();
+    void recordStall(const StallRecord &record);
+
+    esp_timer_handle_t monitorTimer = nullptr;
+    portMUX_TYPE watchdogMux = portMUX_INITIALIZER_UNLOCKED;
+    volatile uint8_t currentSection = NONE;
+    volatile uint32_t enteredAt = 0;
+    unsigned long passStartedAt = 0;
+    uint32_t longestPassMs = 0;
+    uint32_t stallsThisBoot = 0;
+};
+
+extern LoopWatchdog loopWatchdog; // Declaration only
+
+#endif
@@ -1,12 +1,17 @@
 #include "MQTTManager.h"
+#include "Clock/Clock.h"
+#include <base64.h>
 
 MQTTManager mqttManager;
 
-void MQTTManager::initialize(WiFiClient &client, Core &coreRef)
+void MQTTManager::initialize(WiFiClient &client, Core &coreRef, BrokerManager &brokerRef, GroupManager &groupRef)
 {
     mqttClient.setClient(client);
-    mqttClient.setServer(MQTT_SERVER, MQTT_PORT);
+    networkClient = &client;
+    mqttClient.setBufferSize(MQTT_BUFFER_SIZE);
     core = &coreRef;
+    brokers = &brokerRef;
+    groups = &groupRef;
 }
 
 bool MQTTManager::connect()
@@ -14,18 +19,39 @@ bool MQTTManager::connect()
     if (mqttClient.connected())
         return true;
 
-    Serial.print("🔗 Connecting to MQTT...");
+    const BrokerManager::Broker &broker = brokers->current();
+    Serial.print("🔗 Connecting to MQTT " + broker.host + ":" + String(broker.port) + "...");
+    mqttClient.setServer(broker.host.c_str(), broker.port);
     mqttClient.setSocketTimeout(10);
 
-    // Add a small delay to ensure network is ready
-    delay(1000);
-
     String deviceId = core->getDeviceId();
-    if (mqttClient.connect(deviceId.c_str()))
+    String presenceTopic = deviceTopic("status");
+    // Latency is physical, so it is measured on hardware time like the WiFi timeouts
+    unsigned long start = millis();
+    bool connected = mqttClient.connect(deviceId.c_str(), presenceTopic.c_str(), 1, true, "offline");
+    brokers->reportConnectResult(connected, millis() - start, systemClock().now());
+
+    if (connected)
     {
         Serial.println("✅ Connected!");
+        publishRetained(presenceTopic.c_str(), "online");
+        // State may have changed while offline, so republish every relay topic
+        relayStatesPublished = false;
         mqttClient.subscribe(MQTT_TOPIC_RELAY_CONTROL);
         Serial.println("📡 Subscribed to relay control topic: " + String(MQTT_TOPIC_RELAY_CONTROL));
+        mqttClient.subscribe(MQTT_TOPIC_RELAY_EMERGENCY, 1);
+        Serial.println("🚨 Subscribed to emergency topic: " + String(MQTT_TOPIC_RELAY_EMERGENCY));
+        pingTopic = deviceTopic("ping");
+        mqttClient.subscribe(pingTopic.c_str());
+        configTopic = deviceTopic("config");
+        mqttClient.subscribe(configTopic.c_str(), 1);
+        Serial.println("⚙️ Subscribed to config topic: " + configTopic);
+        // The broker replays the retained document right away, which reconciles the relays
+        desiredTopic = deviceTopic("desired");
+        mqttClient.subscribe(desiredTopic.c_str(), 1);
+        Serial.println("🪞 Subscribed to desired state topic: " + desiredTopic);
+        subscribeGroups();
+        lastPing = millis() - PING_INTERVAL_MS; // Measure RTT right away
         return true;
     }
     else
@@ -35,9 +61,71 @@ bool MQTTManager::connect()
     }
 }
 
+void MQTTManager::subscribeGroups()
+{
+    if (!mqttClient.connected())
+        return;
+    for (int i = 0; i < groups->getGroupCount(); i++)
+    {
+        String topic = groups->getTopic(i);
+        mqttClient.subscribe(topic.c_str());
+        Serial.println("👥 Subscribed to group topic: " + topic);
+    }
+}
+
+void MQTTManager::unsubscribeGroups()
+{
+    if (!mqttClient.connected())
+        return;
+    for (int i = 0; i < groups->getGroupCount(); i++)
+        mqttClient.unsubscribe(groups->getTopic(i).c_str());
+}
+
+void MQTTManager::disconnectGracefully()
+{
+    // A clean DISCONNECT suppresses the Last Will, so report offline ourselves
+    publishRetained(deviceTopic("status").c_str(), "offline");
+    mqttClient.disconnect();
+}
+
+bool MQTTManager::handleInternalMessage(const char *topic, const byte *payload, unsigned int length)
+{
+    if (pingTopic != topic)
+        return false;
+
+    char sentAt[16];
+    unsigned int copy = length < sizeof(sentAt) - 1 ? length : sizeof(sentAt) - 1;
+    memcpy(sentAt, payload, copy);
+    sentAt[copy] = '\0';
+    brokers->reportRtt(millis() - strtoul(sentAt, nullptr, 10));
+    return true;
+}
+
 void MQTTManager::loop()
 {
+    unsigned long now = systemClock().now();
+    if (reconnectRequested || brokers->probe(now))
+    {
+        reconnectRequested = false;
+        if (mqttClient.connected())
+            disconnectGracefully();
+        return;
+    }
+
+    // The ping carries hardware time: a simulated clock would distort the measured RTT
+    unsigned long pingNow = millis();
+    if (mqttClient.connected() && pingNow - lastPing >= PING_INTERVAL_MS)
+    {
+        mqttClient.publish(pingTopic.c_str(), String(pingNow).c_str());
+        lastPing = pingNow;
+    }
+
+
+    // PubSubClient handles one packet per call; drain a backlog so an emergency command
+    // queued behind routine traffic is read within the same pass
     mqttClient.loop();
+    for (int i = 1; i < MAX_MESSAGES_PER_LOOP && networkClient->available() > 0; i++)
+        mqttClient.loop();
 }
 
 void MQTTManager::setCallback(void (*callback)(char *, byte *, unsigned int))
@@ -50,6 +138,39 @@ bool MQTTManager::publish(const char *topic, const char *message)
     return mqttClient.publish(topic, message);
 }
 
+bool MQTTManager::publishRetained(const char *topic, const char *message)
+{
+    return mqttClient.publish(topic, message, true);
+}
+
+String MQTTManager::deviceTopic(const String &suffix) const
+{
+    return "green-tech/" + core->getDeviceId() + "/" + suffix;
+}
+
+void MQTTManager::publishRelayStates(const bool *relayStates, int relayCount)
+{
+    if (!isConnected())
+        return;
+
+    for (int i = 0; i < relayCount && i < 32; i++)
+    {
+        bool published = publishedRelayMask & (1UL << i);
+        if (relayStatesPublished && published == relayStates[i])
+            continue;
+
+        String topic = deviceTopic("relay/" + String(i) + "/state");
+        if (!publishRetained(topic.c_str(), relayStates[i] ? "on" : "off"))
+            return; // Retry the remaining relays on the next call
+
+        if (relayStates[i])
+            publishedRelayMask |= (1UL << i);
+        else
+            publishedRelayMask &= ~(1UL << i);
+    }
+    relayStatesPublished = true;
+}
+
 bool MQTTManager::sendCredentials(const String &username, const String &password)
 {
     Serial.println("🔄 Attempting to send credentials to database via MQTT...");
@@ -64,7 +185,7 @@ bool MQTTManager::sendCredentials(const String &username, const String &password
     doc["deviceId"] = core->getDeviceId();
     doc["username"] = username;
     doc["password"] = password;
-    doc["timestamp"] = millis();
+    doc["timestamp"] = systemClock().now();
 
     String message;
     serializeJson(doc, message);
@@ -86,7 +207,8 @@ bool MQTTManager::sendCredentials(const String &username, const String &password
     return success;
 }
 
-void MQTTManager::sendRelayStatus(int relayIndex, bool state, unsigned long timer)
+void MQTTManager::sendRelayStatus(int relayIndex, bool state, unsigned long timer, uint32_t version,
+                                  const TraceRecord *trace)
 {
     if (!isConnected())
         return;
@@ -96,36 +218,300 @@ void MQTTManager::sendRelayStatus(int relayIndex, bool state, unsigned long time
     doc["relay"] = relayIndex;
     doc["state"] = state;
     doc["timer"] = timer;
-    doc["timestamp"] = millis();
+    doc["version"] = version;
+    doc["timestamp"] = systemClock().now();
+    if (trace)
+        trace->toJson(doc["trace"].to<JsonObject>());
 
     String message;
     serializeJson(doc, message);
     publish(MQTT_TOPIC_RELAY_STATUS, message.c_str());
 }
 
-void MQTTManager::sendDeviceStatus(const String &deviceId, const bool *relayStates,
-                                   const unsigned long *relayTimers, int relayCount)
+void MQTTManager::sendTraces(const CommandTracer &tracer)
 {
     if (!isConnected())
         return;
 
+    // A full ring can exceed the packet buffer, so the records go out in as many parts as
+    // needed, each sized with measureJson() before it is published
+    const size_t limit = MQTT_BUFFER_SIZE - MQTT_PACKET_OVERHEAD - strlen(MQTT_TOPIC_TRACES);
+    TraceRecord records[CommandTracer::RING_SIZE];
+    int count = tracer.snapshot(records);
+    int next = 0;
+    int part = 0;
+    do
+    {
+        JsonDocument doc;
+        doc["deviceId"] = core->getDeviceId();
+        doc["part"] = part;
+        doc["final"] = false;
+        JsonArray traces = doc["traces"].to<JsonArray>();
+        while (next < count)
+        {
+            records[next].toJson(traces.add<JsonObject>());
+            if (traces.size() > 1 && measureJson(doc) > limit)
+            {
+                traces.remove(traces.size() - 1);
+                break;
+            }
+            next++;
+        }
+        doc["final"] = next >= count; // "true" is shorter than "false", so the part still fits
+
+        String message;
+        serializeJson(doc, message);
+        if (!publish(MQTT_TOPIC_TRACES, message.c_str()))
+        {
+            Serial.println("⚠️ Trace part " + String(part) + " could not be published");
+            return;
+        }
+        part++;
+    } while (next < count);
+}
+
+bool MQTTManager::sendDeviceStatus(const RelaySnapshot &snapshot)
+{
+    if (!isConnected())
+        return false;
+
     JsonDocument doc;
-    doc["deviceId"] = deviceId;
+    doc["deviceId"] = core->getDeviceId();
+    doc["timestamp"] = systemClock().now();
+    fillDeviceStatus(doc, snapshot);
+
+    String message;
+    serializeJson(doc, message);
+    return publish(MQTT_TOPIC_DEVICE_STATUS, message.c_str());
+}
+
+void MQTTManager::fillDeviceStatus(JsonDocument &doc, const RelaySnapshot &snapshot)
+{
     doc["ip"] = WiFi.localIP().toString();
     doc["rssi"] = WiFi.RSSI();
     doc["uptime"] = core->getUptime();
-    doc["timestamp"] = millis();
+    doc["version"] = snapshot.version;
+    groups->fillGroups(doc["groups"].to<JsonArray>());
 
     JsonArray relays = doc["relays"].to<JsonArray>();
-    for (int i = 0; i < relayCount; i++)
+    for (int i = 0; i < RelaySnapshot::MAX_RELAYS; i++)
     {
         JsonObject relay = relays.add<JsonObject>();
         relay["index"] = i;
-        relay["state"] = relayStates[i];
-        relay["timer"] = relayTimers[i];
+        relay["state"] = snapshot.states[i];
+        relay["timer"] = snapshot.timers[i];
     }
+}
+
+// Replies may only go to green-tech/<requester>/response[/...], so a query cannot make the
+// device publish onto a control, config or desired-state topic
+bool MQTTManager::isResponseTopic(const String &topic)
+{
+    static const char PREFIX[] = "green-tech/";
+    static const char SUFFIX[] = "/response";
+    if (topic.length() > MAX_REPLY_TOPIC_LENGTH || topic.indexOf('+') >= 0 || topic.indexOf('#') >= 0 ||
+        !topic.startsWith(PREFIX))
+        return false;
+
+    int segmentEnd = topic.indexOf('/', sizeof(PREFIX) - 1);
+    if (segmentEnd <= (int)sizeof(PREFIX) - 1 || !topic.substring(segmentEnd).startsWith(SUFFIX))
+        return false;
+    int rest = segmentEnd + sizeof(SUFFIX) - 1;
+    return (int)topic.length() == rest || topic[rest] == '/';
+}
+
+bool MQTTManager::sendResponse(const char *replyTo, JsonDocument &doc)
+{
+    if (!isConnected())
+        return false;
+
+    String topic = replyTo && *replyTo ? String(replyTo) : deviceTopic("response");
+    if (!isResponseTopic(topic))
+    {
+        Serial.println("⚠️ Query dropped, invalid reply topic: " + topic);
+        return false;
+    }
+
+    doc["deviceId"] = core->getDeviceId();
+    doc["timestamp"] = systemClock().now();
+    size_t length = serializeJson(doc, responseBuffer, sizeof(responseBuffer));
+    if (length >= sizeof(responseBuffer) - 1)
+    {
+        // Truncated: answer with an error the caller can still correlate
+        JsonDocument error;
+        error["deviceId"] = core->getDeviceId();
+        error["correlationId"] = doc["correlationId"];
+        error["query"] = doc["query"];
+        error["status"] = "error";
+        error["error"] = "response too large";
+        length = serializeJson(error, responseBuffer, sizeof(responseBuffer));
+    }
+    return mqttClient.publish(topic.c_str(), (const uint8_t *)responseBuffer, length, false);
+}
+
+bool MQTTManager::sendStatusDelta(JsonDocument &doc)
+{
+    if (!isConnected())
+        return false;
+
+    doc["deviceId"] = core->getDeviceId();
+    doc["timestamp"] = systemClock().now();
+
+    String message;
+    serializeJson(doc, message);
+    return publish(MQTT_TOPIC_STATUS_DELTA, message.c_str());
+}
+
+bool MQTTManager::sendHeartbeat(uint32_t version)
+{
+    if (!isConnected())
+        return false;
+
+    char message[128];
+    snprintf(message, sizeof(message), "{\"deviceId\":\"%s\",\"rssi\":%d,\"uptime\":%lu,\"version\":%lu}",
+             core->getDeviceId().c_str(), (int)WiFi.RSSI(), (unsigned long)core->getUptime(), (unsigned long)version);
+    return publish(MQTT_TOPIC_HEARTBEAT, message);
+}
+
+void MQTTManager::sendBootProfile()
+{
+    if (!isConnected())
+        return;
+
+    JsonDocument doc;
+    doc["deviceId"] = core->getDeviceId();
+    doc["resetReason"] = core->getResetReason();
+
+    JsonArray phases = doc["phases"].to<JsonArray>();
+    const BootPhase *bootPhases = core->getBootPhases();
+    for (int i = 0; i < core->getBootPhaseCount(); i++)
+    {
+        JsonObject phase = phases.add<JsonObject>();
+        phase["name"] = bootPhases[i].name;
+        phase["at"] = bootPhases[i].at;
+    }
+
+    String message;
+    serializeJson(doc, message);
+    publish(MQTT_TOPIC_BOOT_PROFILE, message.c_str());
+}
+
+bool MQTTManager::sendStallReport(JsonDocument &doc)
+{
+    if (!isConnected())
+        return false;
+
+    doc["deviceId"] = core->getDeviceId();
+    doc["resetReason"] = core->getResetReason();
+    doc["timestamp"] = systemClock().now();
+
+    String message;
+    serializeJson(doc, message);
+    return publish(MQTT_TOPIC_STALL_REPORT, message.c_str());
+}
+
+void MQTTManager::sendProgramStatus(JsonDocument &doc)
+{
+    if (!isConnected())
+        return;
+
+    doc["deviceId"] = core->getDeviceId();
+    doc["timestamp"] = systemClock().now();
+
+    String message;
+    serializeJson(doc, message);
+    publish(MQTT_TOPIC_PROGRAM_STATUS, message.c_str());
+}
+
+bool MQTTManager::sendReportedState(JsonDocument &doc)
+{
+    if (!isConnected())
+        return false;
+
+    doc["deviceId"] = core->getDeviceId();
+    doc["timestamp"] = systemClock().now();
+
+    String message;
+    serializeJson(doc, message);
+    return publishRetained(deviceTopic("reported").c_str(), message.c_str());
+}
+
+void MQTTManager::sendMetrics(JsonDocument &doc)
+{
+    if (!isConnected())
+        return;
+
+    doc["deviceId"] = core->getDeviceId();
+    doc["timestamp"] = systemClock().now();
+
+    String message;
+    serializeJson(doc, message);
+    publish(MQTT_TOPIC_METRICS, message.c_str());
+}
+
+bool MQTTManager::sendTelemetry(JsonDocument &doc)
+{
+    if (!isConnected())
+        return false;
+
+    doc["deviceId"] = core->getDeviceId();
+
+    String message;
+    serializeJson(doc, message);
+    return publish(MQTT_TOPIC_TELEMETRY, message.c_str());
+}
+
+bool MQTTManager::sendHistoryChunk(uint32_t bootId, uint32_t sequence, const uint8_t *data, size_t size)
+{
+    if (!isConnected())
+        return false;
+
+    JsonDocument doc;
+    doc["deviceId"] = core->getDeviceId();
+    doc["bootId"] = bootId;
+    doc["seq"] = sequence;
+    doc["uptime"] = systemClock().now(); // Anchors the chunk's uptime timestamps to wall-clock time
+    doc["data"] = base64::encode(data, size);
+
+    String message;
+    serializeJson(doc, message);
+    return publish(MQTT_TOPIC_HISTORY, message.c_str());
+}
+
+void MQTTManager::sendConfigStatus(uint32_t changes, const char *source, const char *error)
+{
+    if (!isConnected())
+        return;
+
+    JsonDocument doc;
+    doc["deviceId"] = core->getDeviceId();
+    doc["source"] = source;
+    ConfigManager::fillChangeNames(changes, doc["changed"].to<JsonArray>());
+    if (error)
+        doc["error"] = error;
+    doc["timestamp"] = systemClock().now();
+
+    String message;
+    serializeJson(doc, message);
+    publish(MQTT_TOPIC_CONFIG_STATUS, message.c_str());
+}
+
+void MQTTManager::sendOtaStatus(const char *state, size_t bytesWritten, size_t totalSize, int retries, const char *error)
+{
+    if (!isConnected())
+        return;
+
+    JsonDocument doc;
+    doc["deviceId"] = core->getDeviceId();
+    doc["state"] = state;
+    doc["written"] = bytesWritten;
+    doc["size"] = totalSize;
+    doc["retries"] = retries;
+    if (error[0] != '\0')
+        doc["error"] = error;
+    doc["timestamp"] = systemClock().now();
 
     String message;
     serializeJson(doc, message);
-    publish(MQTT_TOPIC_DEVICE_STATUS, message.c_str());
+    publish(MQTT_TOPIC_OTA_STATUS, message.c_str());
 }
\ No newline at end of file
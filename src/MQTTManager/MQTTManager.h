@@ -5,32 +5,107 @@
 #include <WiFi.h>
 #include <ArduinoJson.h>
 #include "Core/Core.h"
+#include "BrokerManager/BrokerManager.h"
+#include "GroupManager/GroupManager.h"
+#include "CommandTracer/CommandTracer.h"
+#include "RelayController/RelaySnapshot.h"
+#include "ConfigManager/ConfigManager.h"
 
 class MQTTManager
 {
 public:
-    void initialize(WiFiClient &client, Core &coreRef);
+    void initialize(WiFiClient &client, Core &coreRef, BrokerManager &brokerRef, GroupManager &groupRef);
     bool connect();
     void loop();
+    // Drops the connection at the next loop() so connect() picks up a new broker selection
+    void requestReconnect() { reconnectRequested = true; }
+    // Consumes MQTTManager's own traffic (latency pings); returns true if the message was handled
+    bool handleInternalMessage(const char *topic, const byte *payload, unsigned int length);
     void setCallback(void (*callback)(char *, byte *, unsigned int));
     bool publish(const char *topic, const char *message);
+    bool publishRetained(const char *topic, const char *message);
     bool isConnected() { return mqttClient.connected(); }
+    bool isEmergencyTopic(const char *topic) const { return strcmp(topic, MQTT_TOPIC_RELAY_EMERGENCY) == 0; }
+    // green-tech/<deviceId>/config carries a ConfigManager document without a deviceId
+    bool isConfigTopic(const char *topic) const { return configTopic == topic; }
+    // green-tech/<deviceId>/desired carries the retained desired-state document, see ShadowManager
+    bool isDesiredTopic(const char *topic) const { return desiredTopic == topic; }
+    // Group topics carry commands without a deviceId, see GroupManager
+    bool isGroupTopic(const char *topic) const { return groups->matchTopic(topic) >= 0; }
+    // Call around GroupManager::setGroups() to move subscriptions to the new membership
+    void unsubscribeGroups();
+    void subscribeGroups();
 
     // Specific message methods
     bool sendCredentials(const String &username, const String &password);
-    void sendRelayStatus(int relayIndex, bool state, unsigned long timer);
-    void sendDeviceStatus(const String &deviceId, const bool *relayStates,
-                          const unsigned long *relayTimers, int relayCount);
+    void sendRelayStatus(int relayIndex, bool state, unsigned long timer, uint32_t version,
+                         const TraceRecord *trace = nullptr);
+    void sendTraces(const CommandTracer &tracer);
+    // Full status: every relay plus network details. Sent on reconnect and on request only.
+    bool sendDeviceStatus(const RelaySnapshot &snapshot);
+    void fillDeviceStatus(JsonDocument &doc, const RelaySnapshot &snapshot);
+    // Reply to a query on replyTo (green-tech/<deviceId>/response if empty)
+    bool sendResponse(const char *replyTo, JsonDocument &doc);
+    // Relays changed since the last report, see StatusReporter
+    bool sendStatusDelta(JsonDocument &doc);
+    // Liveness only: RSSI, uptime and the last reported state version
+    bool sendHeartbeat(uint32_t version);
+    // Publishes green-tech/<deviceId>/relay/<n>/state (retained) for relays whose state changed
+    void publishRelayStates(const bool *relayStates, int relayCount);
+    void sendBootProfile();
+    // Loop stalls recorded by LoopWatchdog, published after each reconnect until delivered
+    bool sendStallReport(JsonDocument &doc);
+    void sendProgramStatus(JsonDocument &doc);
+    // Retained on green-tech/<deviceId>/reported
+    bool sendReportedState(JsonDocument &doc);
+    void sendMetrics(JsonDocument &doc);
+    bool sendTelemetry(JsonDocument &doc);
+    bool sendHistoryChunk(uint32_t bootId, uint32_t sequence, const uint8_t *data, size_t size);
+    void sendConfigStatus(uint32_t changes, const char *source, const char *error);
+    void sendOtaStatus(const char *state, size_t bytesWritten, size_t totalSize, int retries, const char *error);
 
 private:
+    String deviceTopic(const String &suffix) const;
+    static bool isResponseTopic(const String &topic);
+    void disconnectGracefully();
+
     PubSubClient mqttClient;
+    WiFiClient *networkClient = nullptr;
     Core *core;
-    const char *MQTT_SERVER = "34.229.153.185";
-    const int MQTT_PORT = 1883;
+    BrokerManager *brokers;
+    GroupManager *groups;
+    String pingTopic;
+    String configTopic;
+    String desiredTopic;
+    unsigned long lastPing = 0;
+    bool reconnectRequested = false;
+    uint32_t publishedRelayMask = 0;
+    bool relayStatesPublished = false;
+    const unsigned long PING_INTERVAL_MS = 60000;
     const char *MQTT_TOPIC_CREDENTIALS = "green-tech/credentials";
     const char *MQTT_TOPIC_RELAY_CONTROL = "green-tech/relay-control";
+    const char *MQTT_TOPIC_RELAY_EMERGENCY = "green-tech/relay-emergency";
     const char *MQTT_TOPIC_RELAY_STATUS = "green-tech/relay-status";
     const char *MQTT_TOPIC_DEVICE_STATUS = "green-tech/device-status";
+    const char *MQTT_TOPIC_STATUS_DELTA = "green-tech/status-delta";
+    const char *MQTT_TOPIC_HEARTBEAT = "green-tech/heartbeat";
+    const char *MQTT_TOPIC_OTA_STATUS = "green-tech/ota-status";
+    const char *MQTT_TOPIC_CONFIG_STATUS = "green-tech/config-status";
+    const char *MQTT_TOPIC_BOOT_PROFILE = "green-tech/boot-profile";
+    const char *MQTT_TOPIC_STALL_REPORT = "green-tech/stall-report";
+    const char *MQTT_TOPIC_PROGRAM_STATUS = "green-tech/program-status";
+    const char *MQTT_TOPIC_METRICS = "green-tech/metrics";
+    const char *MQTT_TOPIC_TELEMETRY = "green-tech/telemetry";
+    const char *MQTT_TOPIC_HISTORY = "green-tech/history";
+    const char *MQTT_TOPIC_TRACES = "green-tech/traces";
+    const int MAX_MESSAGES_PER_LOOP = 16;
+    const uint16_t MQTT_BUFFER_SIZE = 2048; // PubSubClient's 256 byte default cannot hold a full status
+    static const size_t MQTT_PACKET_OVERHEAD = 7; // Fixed header plus topic length, excluding the topic
+    // Responses are serialized once into this buffer; with the topic capped they still fit
+    // PubSubClient's packet buffer
+    static const size_t RESPONSE_BUFFER_SIZE = 1792;
+    static const size_t MAX_REPLY_TOPIC_LENGTH = 128;
+    char responseBuffer[RESPONSE_BUFFER_SIZE];
 };
 
 extern MQTTManager mqttManager; // Declaration only
@@ -0,0 +1,62 @@
+#ifndef OTA_MANAGER_H
+#define OTA_MANAGER_H
+
+#include <Arduino.h>
+#include <mbedtls/sha256.h>
+
+class OTAManager
+{
+public:
+    enum State
+    {
+        IDLE,
+        DOWNLOADING,
+        VERIFYING,
+        SUCCESS,
+        FAILED
+    };
+
+    // Starts a background download of url, which must be https, into the inactive app
+    // partition. sha256 is the expected image digest as 64 hex characters; it guards
+    // against a corrupted download, not against a malicious image.
+    bool begin(const String &url, const String &sha256, size_t size, bool rebootWhenDone);
+    bool isRunning() const { return state == DOWNLOADING || state == VERIFYING; }
+
+    // Returns true once per state or progress change so the caller can report it
+    bool takeStatusChange();
+    State getState() const { return state; }
+    const char *getStateName() const;
+    const char *getError() const { return error; }
+    size_t getBytesWritten() const { return bytesWritten; }
+    size_t getTotalSize() const { return totalSize; }
+    int getRetries() const { return retries; }
+    bool shouldReboot() const { return state == SUCCESS && rebootAfterUpdate; }
+
+    static const size_t CHUNK_SIZE = 4096; // One flash sector per write
+    static const int MAX_RETRIES = 10;
+
+private:
+    static void taskEntry(void *param);
+    void run();
+    int downloadFrom(size_t offset);
+    void fail(const char *reason);
+
+    String imageUrl;
+    String expectedSha256;
+    bool rebootAfterUpdate = true;
+
+    volatile State state = IDLE;
+    volatile size_t bytesWritten = 0;
+    volatile size_t totalSize = 0;
+    volatile int retries = 0;
+    volatile bool statusChanged = false;
+    const char *error = "";
+    int lastReportedPercent = -1;
+
+    mbedtls_sha256_context shaContext;
+    uint8_t chunk[CHUNK_SIZE];
+};
+
+extern OTAManager otaManager; // Declaration only
+
+#endif
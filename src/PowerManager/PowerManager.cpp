@@ -0,0 +1,99 @@
+#include "PowerManager.h"
+#include <lwip/sockets.h>
+#include <esp_wifi.h>
+#include <esp_timer.h>
+#if CONFIG_PM_ENABLE
+#include <esp_pm.h>
+#endif
+
+PowerManager powerManager;
+
+void PowerManager::initialize(bool enableLightSleep)
+{
+    // Modem sleep: the radio sleeps between DTIM beacons while staying associated
+    WiFi.setSleep(true);
+    esp_wifi_set_ps(WIFI_PS_MIN_MODEM);
+
+    configureLightSleep(enableLightSleep);
+    windowStart = esp_timer_get_time();
+}
+
+void PowerManager::setLightSleep(bool enable)
+{
+    if (enable != lightSleepEnabled)
+        configureLightSleep(enable);
+}
+
+void PowerManager::configureLightSleep(bool enable)
+{
+#if CONFIG_PM_ENABLE
+#if ESP_IDF_VERSION_MAJOR >= 5
+    esp_pm_config_t pmConfig = {};
+#else
+    esp_pm_config_esp32_t pmConfig = {};
+#endif
+    pmConfig.max_freq_mhz = 240;
+    pmConfig.min_freq_mhz = enable ? 80 : 240;
+    pmConfig.light_sleep_enable = enable;
+    lightSleepEnabled = esp_pm_configure(&pmConfig) == ESP_OK && enable;
+#else
+    if (enable)
+        Serial.println("⚠️ Light sleep needs CONFIG_PM_ENABLE, using modem sleep only");
+#endif
+
+    Serial.println(lightSleepEnabled ? "😴 Power: modem + light sleep" : "😴 Power: modem sleep");
+}
+
+void PowerManager::waitForActivity(WiFiClient &client, unsigned long timeoutMs)
+{
+    if (timeoutMs == 0)
+        return;
+    if (timeoutMs > MAX_IDLE_WAIT_MS)
+        timeoutMs = MAX_IDLE_WAIT_MS;
+
+    int64_t start = esp_timer_get_time();
+
+    int fd = client.connected() ? client.fd() : -1;
+    if (fd >= 0 && client.available() == 0)
+    {
+        fd_set readSet;
+        FD_ZERO(&readSet);
+        FD_SET(fd, &readSet);
+        struct timeval timeout;
+        timeout.tv_sec = timeoutMs / 1000;
+        timeout.tv_usec = (timeoutMs % 1000) * 1000;
+        select(fd + 1, &readSet, nullptr, nullptr, &timeout);
+    }
+    else if (fd < 0)
+    {
+        vTaskDelay(pdMS_TO_TICKS(timeoutMs));
+    }
+
+    idleMicros += esp_timer_get_time() - start;
+    wakeups++;
+}
+
+void PowerManager::fillMetrics(JsonObject metrics)
+{
+    int64_t window = esp_timer_get_time() - windowStart;
+    if (window <= 0)
+        return;
+
+    float idleFraction = (float)((double)idleMicros / window);
+    if (idleFraction > 1.0f)
+        idleFraction = 1.0f;
+    float busyFraction = 1.0f - idleFraction;
+    float idleCurrent = lightSleepEnabled ? CURRENT_LIGHT_SLEEP_MA : CURRENT_IDLE_MA;
+
+    metrics["cpuPercent"] = serialized(String(busyFraction * 100.0f, 1));
+    metrics["currentMaEstimate"] = serialized(String(busyFraction * CURRENT_ACTIVE_MA + idleFraction * idleCurrent, 1));
+    metrics["loopWakeups"] = wakeups;
+    metrics["lightSleep"] = lightSleepEnabled;
+}
+
+void PowerManager::resetMetrics()
+{
+    windowStart = esp_timer_get_time();
+    idleMicros = 0;
+    wakeups = 0;
+}
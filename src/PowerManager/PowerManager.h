@@ -0,0 +1,44 @@
+#ifndef POWER_MANAGER_H
+#define POWER_MANAGER_H
+
+#include <WiFi.h>
+#include <ArduinoJson.h>
+
+class PowerManager
+{
+public:
+    void initialize(bool enableLightSleep);
+    // Runtime switch, used when the configuration changes
+    void setLightSleep(bool enable);
+
+    // Blocks until the MQTT socket is readable or timeoutMs elapses. The idle task runs
+    // meanwhile, letting modem sleep (and light sleep if enabled) power down.
+    void waitForActivity(WiFiClient &client, unsigned long timeoutMs);
+
+    // CPU utilization and estimated supply current for the window since the last
+    // resetMetrics(); filling does not reset
+    void fillMetrics(JsonObject metrics);
+    void resetMetrics();
+
+    // Longest the loop ever blocks, which bounds housekeeping latency
+    static const unsigned long MAX_IDLE_WAIT_MS = 1000;
+
+private:
+    void configureLightSleep(bool enable);
+
+    bool lightSleepEnabled = false;
+    // 64-bit esp_timer time: the window follows the heartbeat interval, and micros()
+    // wraps after about 71 minutes
+    int64_t windowStart = 0;
+    int64_t idleMicros = 0;
+    unsigned long wakeups = 0;
+
+    // Rough ESP32 figures from the datasheet, used only for the current estimate
+    const float CURRENT_ACTIVE_MA = 68.0f;     // CPU at 240 MHz, radio in modem sleep
+    const float CURRENT_IDLE_MA = 20.0f;       // CPU idle, modem sleep with DTIM wakeups
+    const float CURRENT_LIGHT_SLEEP_MA = 3.0f; // Light sleep averaged with DTIM wakeups
+};
+
+extern PowerManager powerManager; // Declaration only
+
+#endif
@@ -22,4 +22,24 @@ void PreferencesManager::setSystemCredentials(const String &username, const Stri
 {
     preferences.putString("sys_username", username);
     preferences.putString("sys_password", password);
+}
+
+void PreferencesManager::setSensorIntervals(unsigned long sampleMs, unsigned long batchMs)
+{
+    preferences.putULong("sample_ms", sampleMs);
+    preferences.putULong("batch_ms", batchMs);
+}
+
+bool PreferencesManager::getWiFiCache(WiFiCache &cache)
+{
+    return preferences.getBytes("wifi_cache", &cache, sizeof(cache)) == sizeof(cache) && cache.channel != 0;
+}
+
+void PreferencesManager::setWiFiCache(const WiFiCache &cache)
+{
+    // Skip the NVS write when nothing changed to spare flash wear on every boot
+    WiFiCache stored;
+    if (getWiFiCache(stored) && memcmp(&stored, &cache, sizeof(cache)) == 0)
+        return;
+    preferences.putBytes("wifi_cache", &cache, sizeof(cache));
 }
\ No newline at end of file
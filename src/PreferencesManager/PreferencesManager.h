@@ -3,6 +3,13 @@
 
 #include <Preferences.h>
 
+// Where the AP was last found, so a join can skip the scan. The IP always comes from DHCP.
+struct WiFiCache
+{
+    uint8_t bssid[6];
+    uint8_t channel;
+};
+
 class PreferencesManager
 {
 public:
@@ -14,6 +21,11 @@ public:
     String getWiFiPassword() { return preferences.getString("wifi_pass", ""); }
     void setWiFiCredentials(const String &ssid, const String &password);
 
+    // Last successful association, reused for a fast reconnect on the next boot
+    bool getWiFiCache(WiFiCache &cache);
+    void setWiFiCache(const WiFiCache &cache);
+    void clearWiFiCache() { preferences.remove("wifi_cache"); }
+
     // System credentials
     String getSystemUsername() { return preferences.getString("sys_username", ""); }
     String getSystemPassword() { return preferences.getString("sys_password", ""); }
@@ -23,6 +35,39 @@ public:
     bool isConfigured() { return preferences.getBool("configured", false); }
     void setConfigured(bool configured) { preferences.putBool("configured", configured); }
 
+    // Power management
+    bool getLightSleepEnabled() { return preferences.getBool("light_sleep", false); }
+    void setLightSleepEnabled(bool enabled) { preferences.putBool("light_sleep", enabled); }
+
+    // Sensor sampling
+    unsigned long getSampleInterval() { return preferences.getULong("sample_ms", 1000); }
+    unsigned long getTelemetryInterval() { return preferences.getULong("batch_ms", 60000); }
+    void setSensorIntervals(unsigned long sampleMs, unsigned long batchMs);
+
+    // Status reporting: liveness heartbeat while no relay changes
+    unsigned long getHeartbeatInterval() { return preferences.getULong("heartbeat_ms", 300000); }
+    void setHeartbeatInterval(unsigned long intervalMs) { preferences.putULong("heartbeat_ms", intervalMs); }
+
+    // Local control rules (JSON array, see RuleEngine)
+    String getRules() { return preferences.getString("rules", "[]"); }
+    void setRules(const String &rules) { preferences.putString("rules", rules); }
+
+    // MQTT brokers (JSON array, see BrokerManager)
+    String getBrokers() { return preferences.getString("brokers", ""); }
+    void setBrokers(const String &brokers) { preferences.putString("brokers", brokers); }
+
+    // Group membership (JSON array of names, see GroupManager)
+    String getGroups() { return preferences.getString("groups", "[]"); }
+    void setGroups(const String &groups) { preferences.putString("groups", groups); }
+
+    // Manual override inputs (JSON array, see InputManager)
+    String getInputs() { return preferences.getString("inputs", "[]"); }
+    void setInputs(const String &inputs) { preferences.putString("inputs", inputs); }
+
+    // Last desired-state version applied, so a redelivered document does not restart timers
+    unsigned long getShadowVersion() { return preferences.getULong("shadow_ver", 0); }
+    void setShadowVersion(unsigned long version) { preferences.putULong("shadow_ver", version); }
+
     // Get Preferences reference for other modules
     Preferences &getPreferences() { return preferences; }
 
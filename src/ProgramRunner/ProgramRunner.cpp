@@ -0,0 +1,285 @@
+#include "ProgramRunner.h"
+
+ProgramRunner programRunner;
+
+// Keeps the program clock well inside unsigned long arithmetic (about 24 days)
+static const uint64_t MAX_PROGRAM_MS = 0x7FFFFFFFULL;
+
+void ProgramRunner::initialize(RelayController &relays)
+{
+    relayController = &relays;
+}
+
+bool ProgramRunner::start(JsonObjectConst program, unsigned long now, String &error)
+{
+    JsonArrayConst items = program["steps"];
+    if (items.isNull() || items.size() == 0 || items.size() > MAX_STEPS)
+    {
+        error = "1 to " + String(MAX_STEPS) + " steps required";
+        return false;
+    }
+    unsigned long repeatCount = program["repeat"] | 1UL;
+    if (repeatCount == 0 || repeatCount > MAX_REPEAT)
+    {
+        error = "repeat must be 1 to " + String(MAX_REPEAT);
+        return false;
+    }
+
+    Step parsed[MAX_STEPS];
+    int count = 0;
+    unsigned long offset = 0;
+    unsigned long longest = 0;
+    for (JsonObjectConst item : items)
+    {
+        int relay = item["relay"] | -1;
+        unsigned long durationS = item["durationS"] | 0UL;
+        unsigned long overlapS = item["overlapS"] | 0UL;
+        if (relay < 0 || relay >= RelayController::RELAY_COUNT || durationS == 0 || durationS > MAX_STEP_S ||
+            overlapS >= durationS)
+        {
+            error = "invalid step " + String(count);
+            return false;
+        }
+
+        parsed[count].relay = relay;
+        parsed[count].startMs = offset;
+        parsed[count].endMs = offset + durationS * 1000;
+        longest = max(longest, parsed[count].endMs);
+        // The next step starts overlapS before this one ends
+        offset = parsed[count].endMs - overlapS * 1000;
+        count++;
+    }
+    if ((uint64_t)longest * repeatCount > MAX_PROGRAM_MS)
+    {
+        error = "program too long";
+        return false;
+    }
+
+    // A new program replaces the running one; release its relays first
+    if (isActive())
+        applyMask(0);
+
+    for (int i = 0; i < count; i++)
+        steps[i] = parsed[i];
+    stepCount = count;
+    cycleMs = longest;
+    repeat = repeatCount;
+    strlcpy(programId, program["id"] | "program", sizeof(programId));
+
+    clockBaseMs = 0;
+    resumedAt = now;
+    reportedStep = -1;
+    reportedCycle = 0;
+    setState(RUNNING);
+    Serial.println("💧 Program " + String(programId) + ": " + String(stepCount) + " step(s), " +
+                   String(cycleMs / 1000) + " s x" + String(repeat));
+    loop(now);
+    return true;
+}
+
+bool ProgramRunner::pause(unsigned long now)
+{
+    if (state != RUNNING)
+        return false;
+    clockBaseMs = getClock(now);
+    applyMask(0);
+    setState(PAUSED);
+    return true;
+}
+
+bool ProgramRunner::resume(unsigned long now)
+{
+    if (state != PAUSED)
+        return false;
+    resumedAt = now;
+    setState(RUNNING);
+    loop(now);
+    return true;
+}
+
+bool ProgramRunner::skip(unsigned long now)
+{
+    if (!isActive())
+        return false;
+
+    unsigned long clock = getClock(now);
+    unsigned long cycleTime = clock % cycleMs;
+    const Step &current = steps[getCurrentStep(cycleTime)];
+    clockBaseMs = clock + (current.endMs - cycleTime);
+    resumedAt = now;
+    statusChanged = true;
+    if (state == RUNNING)
+        loop(now);
+    return true;
+}
+
+void ProgramRunner::stop(unsigned long now)
+{
+    if (!isActive())
+        return;
+    clockBaseMs = getClock(now);
+    applyMask(0);
+    setState(STOPPED);
+}
+
+unsigned long ProgramRunner::getClock(unsigned long now) const
+{
+    return state == RUNNING ? clockBaseMs + (now - resumedAt) : clockBaseMs;
+}
+
+uint32_t ProgramRunner::getDesiredMask(unsigned long cycleTime) const
+{
+    uint32_t mask = 0;
+    for (int i = 0; i < stepCount; i++)
+    {
+        if (steps[i].startMs <= cycleTime && cycleTime < steps[i].endMs)
+            mask |= (1UL << steps[i].relay);
+    }
+    return mask;
+}
+
+// The most recently started step
+int ProgramRunner::getCurrentStep(unsigned long cycleTime) const
+{
+    int current = 0;
+    for (int i = 0; i < stepCount; i++)
+    {
+        if (steps[i].startMs <= cycleTime)
+            current = i;
+    }
+    return current;
+}
+
+// Switches only relays whose desired state changed, leaving other control sources alone
+void ProgramRunner::applyMask(uint32_t desired)
+{
+    uint32_t changed = desired ^ appliedMask;
+    for (int i = 0; i < RelayController::RELAY_COUNT && changed; i++)
+    {
+        if (changed & (1UL << i))
+            relayController->setRelayState(i, (desired & (1UL << i)) != 0);
+    }
+    appliedMask = desired;
+}
+
+void ProgramRunner::setState(State newState)
+{
+    if (state != newState)
+    {
+        state = newState;
+        statusChanged = true;
+        Serial.println("💧 Program " + String(programId) + " → " + getStateName(state));
+    }
+}
+
+void ProgramRunner::loop(unsigned long now)
+{
+    if (state != RUNNING)
+        return;
+
+    unsigned long clock = getClock(now);
+    if (clock >= cycleMs * repeat)
+    {
+        clockBaseMs = cycleMs * repeat;
+        applyMask(0);
+        setState(FINISHED);
+        return;
+    }
+
+    unsigned long cycle = clock / cycleMs;
+    unsigned long cycleTime = clock % cycleMs;
+    applyMask(getDesiredMask(cycleTime));
+
+    int step = getCurrentStep(cycleTime);
+    if (step != reportedStep || cycle != reportedCycle)
+    {
+        reportedStep = step;
+        reportedCycle = cycle;
+        statusChanged = true;
+    }
+}
+
+unsigned long ProgramRunner::getMillisUntilNextEvent(unsigned long now) const
+{
+    if (state != RUNNING)
+        return ULONG_MAX;
+
+    unsigned long clock = getClock(now);
+    if (clock >= cycleMs * repeat)
+        return 0;
+
+    // Next step start or end in this cycle; the cycle ends with the last step
+    unsigned long cycleTime = clock % cycleMs;
+    unsigned long next = cycleMs;
+    for (int i = 0; i < stepCount; i++)
+    {
+        if (steps[i].startMs > cycleTime && steps[i].startMs < next)
+            next = steps[i].startMs;
+        if (steps[i].endMs > cycleTime && steps[i].endMs < next)
+            next = steps[i].endMs;
+    }
+    return next - cycleTime;
+}
+
+uint32_t ProgramRunner::getHeldMask() const
+{
+    if (!isActive())
+        return 0;
+    uint32_t mask = 0;
+    for (int i = 0; i < stepCount; i++)
+        mask |= (1UL << steps[i].relay);
+    return mask;
+}
+
+bool ProgramRunner::takeStatusChange()
+{
+    bool changed = statusChanged;
+    statusChanged = false;
+    return changed;
+}
+
+void ProgramRunner::fillStatus(JsonDocument &doc, unsigned long now) const
+{
+    unsigned long clock = getClock(now);
+    unsigned long total = cycleMs * repeat;
+    if (clock > total)
+        clock = total;
+
+    doc["program"] = programId;
+    doc["state"] = getStateName(state);
+    if (stepCount == 0)
+        return;
+
+    unsigned long cycle = clock / cycleMs;
+    unsigned long cycleTime = clock % cycleMs;
+    int step = getCurrentStep(cycleTime);
+    if (clock == total)
+    {
+        cycle = repeat - 1;
+        step = stepCount - 1;
+    }
+    doc["step"] = step;
+    doc["steps"] = stepCount;
+    doc["relay"] = steps[step].relay;
+    doc["cycle"] = cycle + 1;
+    doc["repeat"] = repeat;
+    doc["elapsedS"] = clock / 1000;
+    doc["remainingS"] = (total - clock) / 1000;
+}
+
+const char *ProgramRunner::getStateName(State state)
+{
+    switch (state)
+    {
+    case RUNNING:
+        return "running";
+    case PAUSED:
+        return "paused";
+    case FINISHED:
+        return "finished";
+    case STOPPED:
+        return "stopped";
+    default:
+        return "idle";
+    }
+}
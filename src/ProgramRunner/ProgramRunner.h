@@ -0,0 +1,87 @@
+#ifndef PROGRAM_RUNNER_H
+#define PROGRAM_RUNNER_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include "RelayController/RelayController.h"
+
+// Runs a whole irrigation program on-device, so a watering cycle no longer depends on the
+// broker delivering one timed command per zone. A program is a list of steps, each switching
+// one relay for a duration; a step may overlap the start of the next one, and the whole
+// sequence may repeat:
+//
+//   {"id": "morning", "repeat": 2,
+//    "steps": [{"relay": 0, "durationS": 300, "overlapS": 5}, {"relay": 1, "durationS": 480}]}
+//
+// The runner works on a program clock that stops while paused. Each pass it works out which
+// steps should be on at the current clock and switches only the relays whose desired state
+// changed, so commands from other sources are not fought over.
+class ProgramRunner
+{
+public:
+    enum State
+    {
+        IDLE,
+        RUNNING,
+        PAUSED,
+        FINISHED,
+        STOPPED
+    };
+
+    void initialize(RelayController &relays);
+    bool start(JsonObjectConst program, unsigned long now, String &error);
+    bool pause(unsigned long now);
+    bool resume(unsigned long now);
+    // Ends the most recently started step now; an overlapping next step keeps running
+    bool skip(unsigned long now);
+    void stop(unsigned long now);
+
+    void loop(unsigned long now);
+    unsigned long getMillisUntilNextEvent(unsigned long now) const;
+    bool isActive() const { return state == RUNNING || state == PAUSED; }
+    // Every relay the active program switches, including steps not yet started
+    uint32_t getHeldMask() const;
+
+    // Set whenever the state or the current step changes; loop() reports progress
+    bool takeStatusChange();
+    void fillStatus(JsonDocument &doc, unsigned long now) const;
+    static const char *getStateName(State state);
+
+    static const int MAX_STEPS = 16;
+    static const int MAX_ID_LENGTH = 24;
+    static const unsigned long MAX_STEP_S = 86400;
+    static const unsigned long MAX_REPEAT = 100;
+
+private:
+    struct Step
+    {
+        uint8_t relay;
+        unsigned long startMs; // Offset within one cycle
+        unsigned long endMs;
+    };
+
+    unsigned long getClock(unsigned long now) const;
+    uint32_t getDesiredMask(unsigned long cycleTime) const;
+    int getCurrentStep(unsigned long cycleTime) const;
+    void applyMask(uint32_t desired);
+    void setState(State newState);
+
+    RelayController *relayController = nullptr;
+    char programId[MAX_ID_LENGTH + 1] = "";
+    Step steps[MAX_STEPS];
+    int stepCount = 0;
+    unsigned long cycleMs = 0;
+    unsigned long repeat = 1;
+
+    State state = IDLE;
+    unsigned long clockBaseMs = 0; // Program clock at the moment of the last resume
+    unsigned long resumedAt = 0;
+    uint32_t appliedMask = 0;      // Relays the runner currently holds on
+    int reportedStep = -1;
+    unsigned long reportedCycle = 0;
+    bool statusChanged = false;
+};
+
+extern ProgramRunner programRunner; // Declaration only
+
+#endif
@@ -0,0 +1,69 @@
+#ifndef RELAY_COMMAND_H
+#define RELAY_COMMAND_H
+
+#include <ArduinoJson.h>
+#include <string.h>
+
+// A decoded relay command, independent of where it came from (MQTT, schedules, ...)
+struct RelayCommand
+{
+    enum Action
+    {
+        NONE,
+        ON,
+        OFF,
+        TOGGLE,
+        TIMER,
+        PULSE
+    };
+
+    int relay = -1;
+    Action action = NONE;
+    unsigned long duration = 0; // seconds, TIMER
+    unsigned long onMs = 0;     // PULSE
+    unsigned long offMs = 0;
+    unsigned long count = 1;
+
+    // Optional end-to-end tracing, see CommandTracer
+    static const int TRACE_ID_LENGTH = 32;
+    char traceId[TRACE_ID_LENGTH] = "";
+    uint64_t sentAt = 0;
+    int64_t receivedAt = 0;
+    int64_t decodedAt = 0;
+    bool deferred = false;
+
+    bool isTraced() const { return traceId[0] != '\0'; }
+
+    static Action parseAction(const char *name)
+    {
+        if (!name)
+            return NONE;
+        if (strcmp(name, "on") == 0)
+            return ON;
+        if (strcmp(name, "off") == 0)
+            return OFF;
+        if (strcmp(name, "toggle") == 0)
+            return TOGGLE;
+        if (strcmp(name, "timer") == 0)
+            return TIMER;
+        if (strcmp(name, "pulse") == 0)
+            return PULSE;
+        return NONE;
+    }
+
+    // Returns false if the document is not a relay command
+    bool decode(JsonDocument &doc)
+    {
+        action = parseAction(doc["action"].as<const char *>());
+        relay = doc["relay"] | -1;
+        duration = doc["duration"] | 0UL;
+        onMs = doc["onMs"] | 0UL;
+        offMs = doc["offMs"] | 0UL;
+        count = doc["count"] | 1UL;
+        strlcpy(traceId, doc["traceId"] | "", sizeof(traceId));
+        sentAt = doc["sentAt"] | (uint64_t)0;
+        return action != NONE;
+    }
+};
+
+#endif
@@ -1,4 +1,6 @@
 #include "RelayController.h"
+#include "Clock/Clock.h"
+#include <driver/gpio.h>
 
 RelayController relayController;
 
@@ -9,6 +11,60 @@ void RelayController::initialize()
         pinMode(RELAY_PINS[i], OUTPUT);
         digitalWrite(RELAY_PINS[i], LOW);
         Serial.println("Initialized Relay " + String(i) + " on pin " + String(RELAY_PINS[i]));
+
+        pulses[i].owner = this;
+        pulses[i].index = i;
+        pulses[i].active = false;
+        esp_timer_create_args_t timerArgs = {};
+        timerArgs.callback = pulseTimerCallback;
+        timerArgs.arg = &pulses[i];
+        timerArgs.dispatch_method = ESP_TIMER_TASK;
+        timerArgs.name = "relay-pulse";
+        esp_timer_create(&timerArgs, &pulses[i].timer);
+    }
+}
+
+void RelayController::writeOutput(int relayIndex, bool state)
+{
+    relayStates[relayIndex] = state;
+    gpio_set_level((gpio_num_t)RELAY_PINS[relayIndex], state ? 1 : 0);
+    lastOutputAt[relayIndex] = esp_timer_get_time();
+}
+
+// Caller holds relayMux, so there is only ever one writer
+void RelayController::publishSnapshot()
+{
+    snapshotSequence++;
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    snapshot.version = stateVersion;
+    snapshot.pulsingMask = 0;
+    for (int i = 0; i < RELAY_COUNT; i++)
+    {
+        snapshot.states[i] = relayStates[i];
+        snapshot.timers[i] = relayTimers[i];
+        if (pulses[i].active)
+            snapshot.pulsingMask |= (1UL << i);
+    }
+
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    snapshotSequence++;
+}
+
+void RelayController::getSnapshot(RelaySnapshot &out) const
+{
+    while (true)
+    {
+        uint32_t before = snapshotSequence;
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (!(before & 1))
+        {
+            out = snapshot;
+            __atomic_thread_fence(__ATOMIC_ACQUIRE);
+            if (snapshotSequence == before)
+                return;
+        }
+        snapshotRetries++;
     }
 }
 
@@ -16,8 +72,15 @@ void RelayController::setRelayState(int relayIndex, bool state)
 {
     if (relayIndex >= 0 && relayIndex < RELAY_COUNT)
     {
-        relayStates[relayIndex] = state;
-        digitalWrite(RELAY_PINS[relayIndex], state ? HIGH : LOW);
+        // A direct command overrides any running pulse pattern
+        bool wasPulsing = cancelPulse(relayIndex);
+
+        portENTER_CRITICAL(&relayMux);
+        if (wasPulsing || relayStates[relayIndex] != state)
+            stateVersion++;
+        writeOutput(relayIndex, state);
+        publishSnapshot();
+        portEXIT_CRITICAL(&relayMux);
         Serial.println("🔌 Relay " + String(relayIndex) + " → " + (state ? "ON" : "OFF"));
     }
 }
@@ -26,25 +89,221 @@ void RelayController::setRelayTimer(int relayIndex, unsigned long duration)
 {
     if (relayIndex >= 0 && relayIndex < RELAY_COUNT)
     {
+        cancelPulse(relayIndex);
+        // Exactly one version step per change: setRelayState() bumps only if the relay was off
+        portENTER_CRITICAL(&relayMux);
+        unsigned long deadline = systemClock().now() + (duration * 1000);
+        relayTimers[relayIndex] = deadline != 0 ? deadline : 1; // 0 means no timer
+        if (relayStates[relayIndex])
+            stateVersion++;
+        portEXIT_CRITICAL(&relayMux);
         setRelayState(relayIndex, true);
-        relayTimers[relayIndex] = millis() + (duration * 1000);
         Serial.println("⏰ Relay " + String(relayIndex) + " timer: " + String(duration) + "s");
     }
 }
 
+void RelayController::applyCommand(const RelayCommand &command)
+{
+    switch (command.action)
+    {
+    case RelayCommand::ON:
+        setRelayState(command.relay, true);
+        break;
+    case RelayCommand::OFF:
+        setRelayState(command.relay, false);
+        break;
+    case RelayCommand::TOGGLE:
+        setRelayState(command.relay, !getRelayState(command.relay));
+        break;
+    case RelayCommand::TIMER:
+        setRelayTimer(command.relay, command.duration);
+        break;
+    case RelayCommand::PULSE:
+        setRelayPulse(command.relay, command.onMs, command.offMs, command.count);
+        break;
+    default:
+        break;
+    }
+}
+
+void RelayController::stopRelay(int relayIndex)
+{
+    forceRelay(relayIndex, false);
+}
+
+void RelayController::forceRelay(int relayIndex, bool state)
+{
+    if (relayIndex < 0 || relayIndex >= RELAY_COUNT)
+        return;
+    portENTER_CRITICAL(&relayMux);
+    // Clearing a running timer is itself a change; setRelayState() bumps only if the level changes
+    if (relayTimers[relayIndex] != 0 && relayStates[relayIndex] == state)
+        stateVersion++;
+    relayTimers[relayIndex] = 0;
+    portEXIT_CRITICAL(&relayMux);
+    setRelayState(relayIndex, state);
+}
+
+bool RelayController::usesPin(int pin) const
+{
+    for (int i = 0; i < RELAY_COUNT; i++)
+    {
+        if (RELAY_PINS[i] == pin)
+            return true;
+    }
+    return false;
+}
+
 void RelayController::checkRelayTimers()
 {
-    unsigned long currentTime = millis();
+    unsigned long currentTime = systemClock().now();
     for (int i = 0; i < RELAY_COUNT; i++)
     {
-        if (relayTimers[i] > 0 && currentTime >= relayTimers[i])
+        if (relayTimers[i] != 0 && Clock::hasReached(currentTime, relayTimers[i]))
         {
-            setRelayState(i, false);
+            portENTER_CRITICAL(&relayMux);
             relayTimers[i] = 0;
+            if (!relayStates[i])
+                stateVersion++;
+            portEXIT_CRITICAL(&relayMux);
+            setRelayState(i, false);
         }
     }
 }
 
+unsigned long RelayController::getMillisUntilNextTimer(unsigned long now) const
+{
+    unsigned long earliest = ULONG_MAX;
+    for (int i = 0; i < RELAY_COUNT; i++)
+    {
+        if (relayTimers[i] != 0)
+        {
+            unsigned long remaining = Clock::getRemaining(now, relayTimers[i]);
+            if (remaining < earliest)
+                earliest = remaining;
+        }
+    }
+    return earliest;
+}
+
+bool RelayController::setRelayPulse(int relayIndex, unsigned long onMs, unsigned long offMs, unsigned long count)
+{
+    if (relayIndex < 0 || relayIndex >= RELAY_COUNT || onMs == 0 || (count != 1 && offMs == 0))
+        return false;
+
+    cancelPulse(relayIndex);
+
+    RelayPulse &pulse = pulses[relayIndex];
+    portENTER_CRITICAL(&relayMux);
+    relayTimers[relayIndex] = 0;
+    pulse.onMs = onMs;
+    pulse.offMs = offMs;
+    pulse.count = count;
+    pulse.completed = 0;
+    pulse.nextEdgeAt = esp_timer_get_time() + (int64_t)onMs * 1000;
+    pulse.active = true;
+    // Individual edges are output levels, not commanded state; only start and end bump the version
+    stateVersion++;
+    writeOutput(relayIndex, true);
+    publishSnapshot();
+    portEXIT_CRITICAL(&relayMux);
+
+    esp_timer_start_once(pulse.timer, (uint64_t)onMs * 1000);
+    Serial.println("〰️ Relay " + String(relayIndex) + " pulse: " + String(onMs) + "ms on / " +
+                   String(offMs) + "ms off x" + (count ? String(count) : String("∞")));
+    return true;
+}
+
+// Stops the pattern without touching the output; returns whether one was running
+bool RelayController::cancelPulse(int relayIndex)
+{
+    portENTER_CRITICAL(&relayMux);
+    bool wasActive = pulses[relayIndex].active;
+    pulses[relayIndex].active = false;
+    portEXIT_CRITICAL(&relayMux);
+
+    // An edge already in flight sees active == false and does nothing
+    if (wasActive)
+        esp_timer_stop(pulses[relayIndex].timer);
+    return wasActive;
+}
+
+void RelayController::pulseTimerCallback(void *arg)
+{
+    RelayPulse *pulse = static_cast<RelayPulse *>(arg);
+    pulse->owner->onPulseEdge(*pulse);
+}
+
+// Runs in the esp_timer task: no Serial, no MQTT, only GPIO and bookkeeping
+void RelayController::onPulseEdge(RelayPulse &pulse)
+{
+    int64_t now = esp_timer_get_time();
+    int64_t delayUs = 0;
+    bool rescheduled = false;
+
+    portENTER_CRITICAL(&relayMux);
+    if (pulse.active)
+    {
+        uint32_t jitter = now > pulse.nextEdgeAt ? (uint32_t)(now - pulse.nextEdgeAt) : 0;
+        pulseEdges++;
+        jitterSumUs += jitter;
+        if (jitter > jitterMaxUs)
+            jitterMaxUs = jitter;
+
+        bool turningOff = relayStates[pulse.index];
+        writeOutput(pulse.index, !turningOff);
+        if (turningOff && pulse.count > 0 && ++pulse.completed >= pulse.count)
+        {
+            pulse.active = false;
+            stateVersion++;
+        }
+        else
+        {
+            // Schedule from the previous target, not from now, so jitter never accumulates
+            pulse.nextEdgeAt += (int64_t)(turningOff ? pulse.offMs : pulse.onMs) * 1000;
+            delayUs = pulse.nextEdgeAt - now;
+            rescheduled = true;
+        }
+        publishSnapshot();
+    }
+    portEXIT_CRITICAL(&relayMux);
+
+    if (rescheduled)
+        esp_timer_start_once(pulse.timer, delayUs > 0 ? delayUs : 0);
+}
+
+void RelayController::fillMetrics(JsonObject metrics)
+{
+    portENTER_CRITICAL(&relayMux);
+    uint32_t edges = pulseEdges;
+    uint32_t maxUs = jitterMaxUs;
+    uint64_t sumUs = jitterSumUs;
+    portEXIT_CRITICAL(&relayMux);
+
+    metrics["pulseEdges"] = edges;
+    metrics["pulseJitterMaxUs"] = maxUs;
+    metrics["pulseJitterAvgUs"] = edges ? (uint32_t)(sumUs / edges) : 0;
+
+    RelaySnapshot current;
+    getSnapshot(current);
+    int on = 0;
+    for (int i = 0; i < RELAY_COUNT; i++)
+        on += current.states[i] ? 1 : 0;
+    metrics["stateVersion"] = current.version;
+    metrics["relaysOn"] = on;
+    metrics["relaysPulsing"] = __builtin_popcount(current.pulsingMask);
+    metrics["snapshotRetries"] = snapshotRetries;
+}
+
+void RelayController::resetMetrics()
+{
+    portENTER_CRITICAL(&relayMux);
+    pulseEdges = 0;
+    jitterMaxUs = 0;
+    jitterSumUs = 0;
+    portEXIT_CRITICAL(&relayMux);
+}
+
 bool RelayController::getRelayState(int relayIndex) const
 {
     return (relayIndex >= 0 && relayIndex < RELAY_COUNT) ? relayStates[relayIndex] : false;
@@ -2,6 +2,10 @@
 #define RELAY_CONTROLLER_H
 
 #include <Arduino.h>
+#include <ArduinoJson.h>
+#include <esp_timer.h>
+#include "RelayCommand.h"
+#include "RelaySnapshot.h"
 
 class RelayController
 {
@@ -9,23 +13,77 @@ public:
     void initialize();
     void setRelayState(int relayIndex, bool state);
     void setRelayTimer(int relayIndex, unsigned long duration);
+    void applyCommand(const RelayCommand &command);
+    // Emergency stop: cancels the relay's timer and pulse pattern and switches it off
+    void stopRelay(int relayIndex);
+    // Manual override: cancels the relay's timer and pulse pattern and sets the state.
+    // Safe to call from any task.
+    void forceRelay(int relayIndex, bool state);
+    bool usesPin(int pin) const;
     void checkRelayTimers();
+
+    // Millisecond pulses driven by esp_timer, independent of loop() latency.
+    // count == 1 is a single pulse, count > 1 a pulse train, count == 0 repeats until the
+    // relay gets any other command. Whether a relay is pulsing is in the snapshot.
+    bool setRelayPulse(int relayIndex, unsigned long onMs, unsigned long offMs, unsigned long count);
+    // Pulse jitter covers the window since the last resetMetrics(); filling does not reset
+    void fillMetrics(JsonObject metrics);
+    void resetMetrics();
+
+    unsigned long getMillisUntilNextTimer(unsigned long now) const;
     bool getRelayState(int relayIndex) const;
     unsigned long getRelayTimer(int relayIndex) const;
 
-    // Provide access to arrays for MQTT
-    const bool *getRelayStates() const { return relayStates; }
-    const unsigned long *getRelayTimers() const { return relayTimers; }
+    // esp_timer_get_time() of the relay's most recent GPIO write
+    int64_t getLastOutputTime(int relayIndex) const { return lastOutputAt[relayIndex]; }
 
-    static const int RELAY_COUNT = 20;
+    // Consistent view of all relays for readers on any task (status publisher, web API, metrics).
+    // Never blocks the writers; retries only if a write lands during the copy.
+    void getSnapshot(RelaySnapshot &snapshot) const;
+
+    static const int RELAY_COUNT = RelaySnapshot::MAX_RELAYS;
 
 private:
+    struct RelayPulse
+    {
+        RelayController *owner;
+        int index;
+        esp_timer_handle_t timer;
+        volatile bool active;
+        uint32_t onMs;
+        uint32_t offMs;
+        uint32_t count;
+        uint32_t completed;
+        int64_t nextEdgeAt; // esp_timer_get_time() of the scheduled edge
+    };
+
+    static void pulseTimerCallback(void *arg);
+    void onPulseEdge(RelayPulse &pulse);
+    bool cancelPulse(int relayIndex);
+    void writeOutput(int relayIndex, bool state);
+    void publishSnapshot();
+
     const int RELAY_PINS[RELAY_COUNT] = {
         2, 4, 5, 12, 13, 14, 15, 16, 17, 18,
         19, 21, 22, 23, 25, 26, 27, 32, 33, 35}; // Changed 34 to 35
 
     bool relayStates[RELAY_COUNT] = {false};
+    int64_t lastOutputAt[RELAY_COUNT] = {0};
     unsigned long relayTimers[RELAY_COUNT] = {0};
+    uint32_t stateVersion = 0; // Bumped on every state or timer change, published in the snapshot
+
+    RelayPulse pulses[RELAY_COUNT];
+    portMUX_TYPE relayMux = portMUX_INITIALIZER_UNLOCKED;
+
+    // Sequence lock: odd while publishSnapshot() is writing, bumped again when done
+    RelaySnapshot snapshot;
+    volatile uint32_t snapshotSequence = 0;
+    mutable volatile uint32_t snapshotRetries = 0;
+
+    // Edge jitter (actual minus scheduled), reset on each metrics report
+    volatile uint32_t pulseEdges = 0;
+    volatile uint32_t jitterMaxUs = 0;
+    volatile uint64_t jitterSumUs = 0;
 };
 
 extern RelayController relayController; // Declaration only
@@ -0,0 +1,20 @@
+#ifndef RELAY_SNAPSHOT_H
+#define RELAY_SNAPSHOT_H
+
+#include <stdint.h>
+
+// A consistent copy of every relay's state, all taken at the same state version.
+// Published by RelayController under a sequence lock, see RelayController::getSnapshot().
+struct RelaySnapshot
+{
+    static const int MAX_RELAYS = 20;
+
+    uint32_t version = 0;     // RelayController state version this copy belongs to
+    uint32_t pulsingMask = 0; // bit i set while relay i runs a pulse pattern
+    bool states[MAX_RELAYS] = {false};
+    unsigned long timers[MAX_RELAYS] = {0}; // systemClock() deadline, 0 = no timer
+
+    bool isPulsing(int relayIndex) const { return pulsingMask & (1UL << relayIndex); }
+};
+
+#endif
@@ -0,0 +1,125 @@
+#include "RuleEngine.h"
+#include "Clock/Clock.h"
+
+RuleEngine ruleEngine;
+
+void RuleEngine::initialize(RelayController &relays)
+{
+    relayController = &relays;
+}
+
+// Expects a JSON array: [{"relay": 3, "sensor": "moisture", "on": 30, "off": 45,
+//                         "maxRuntime": 600, "cooldown": 1800}, ...] (times in seconds)
+bool RuleEngine::loadRules(const String &json)
+{
+    JsonDocument doc;
+    if (deserializeJson(doc, json) || !doc.is<JsonArray>())
+        return false;
+
+    // Release relays held by the old rule set before replacing it
+    for (int i = 0; i < ruleCount; i++)
+    {
+        if (rules[i].active)
+            switchRule(rules[i], false, systemClock().now(), "rules replaced");
+    }
+
+    ruleCount = 0;
+    suspended = false;
+    for (JsonObject item : doc.as<JsonArray>())
+    {
+        if (ruleCount >= MAX_RULES)
+            break;
+
+        int relay = item["relay"] | -1;
+        if (relay < 0 || relay >= RelayController::RELAY_COUNT)
+            continue;
+
+        String sensor = item["sensor"] | "moisture";
+        Rule &rule = rules[ruleCount];
+        rule.relay = relay;
+        rule.sensor = sensor == "temperature" ? TEMPERATURE : sensor == "flow" ? FLOW : SOIL_MOISTURE;
+        rule.onThreshold = item["on"] | 0.0f;
+        rule.offThreshold = item["off"] | 0.0f;
+        rule.maxRuntimeMs = (item["maxRuntime"] | 0UL) * 1000UL;
+        rule.cooldownMs = (item["cooldown"] | 0UL) * 1000UL;
+        rule.active = false;
+        rule.startedAt = 0;
+        rule.stoppedAt = systemClock().now() - rule.cooldownMs;
+        ruleCount++;
+    }
+
+    Serial.println("📐 Loaded " + String(ruleCount) + " control rules");
+    return true;
+}
+
+float RuleEngine::sensorValue(const SensorReading &reading, uint8_t sensor)
+{
+    switch (sensor)
+    {
+    case TEMPERATURE:
+        return reading.temperature;
+    case FLOW:
+        return reading.flowRate;
+    default:
+        return reading.soilMoisture;
+    }
+}
+
+// The caller has already switched the relays off; the rules only forget they own them
+void RuleEngine::suspend()
+{
+    unsigned long now = systemClock().now();
+    for (int i = 0; i < ruleCount; i++)
+    {
+        if (rules[i].active)
+        {
+            rules[i].active = false;
+            rules[i].stoppedAt = now;
+        }
+    }
+    suspended = true;
+    Serial.println("📐 Rules suspended until the rule set is reloaded");
+}
+
+void RuleEngine::evaluate(const SensorReading &reading)
+{
+    if (suspended)
+        return;
+
+    unsigned long now = reading.timestamp;
+    for (int i = 0; i < ruleCount; i++)
+    {
+        Rule &rule = rules[i];
+        float value = sensorValue(reading, rule.sensor);
+        bool onWhenBelow = rule.onThreshold < rule.offThreshold;
+
+        if (rule.active)
+        {
+            bool released = onWhenBelow ? value >= rule.offThreshold : value <= rule.offThreshold;
+            if (released)
+                switchRule(rule, false, now, "threshold");
+            else if (rule.maxRuntimeMs > 0 && now - rule.startedAt >= rule.maxRuntimeMs)
+                switchRule(rule, false, now, "max runtime");
+        }
+        else if (now - rule.stoppedAt >= rule.cooldownMs)
+        {
+            bool triggered = onWhenBelow ? value < rule.onThreshold : value > rule.onThreshold;
+            if (triggered)
+                switchRule(rule, true, now, "threshold");
+        }
+    }
+}
+
+void RuleEngine::switchRule(Rule &rule, bool on, unsigned long now, const char *reason)
+{
+    rule.active = on;
+    if (on)
+        rule.startedAt = now;
+    else
+        rule.stoppedAt = now;
+
+    relayController->setRelayState(rule.relay, on);
+    Serial.println("📐 Rule → relay " + String(rule.relay) + (on ? " ON (" : " OFF (") + reason + ")");
+    if (actuationCallback)
+        actuationCallback(rule.relay);
+}
@@ -0,0 +1,60 @@
+#ifndef RULE_ENGINE_H
+#define RULE_ENGINE_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include "SensorManager/SensorManager.h"
+#include "RelayController/RelayController.h"
+
+// On-device threshold rules evaluated on every new sensor reading.
+// A rule with onThreshold < offThreshold switches on below onThreshold and off above
+// offThreshold (irrigate when dry); with onThreshold > offThreshold it works the other
+// way round (ventilate when hot). The gap between the two is the hysteresis band.
+class RuleEngine
+{
+public:
+    enum Sensor
+    {
+        SOIL_MOISTURE,
+        TEMPERATURE,
+        FLOW
+    };
+
+    void initialize(RelayController &relays);
+    bool loadRules(const String &json);
+    int getRuleCount() const { return ruleCount; }
+    void evaluate(const SensorReading &reading);
+    // Emergency all-off: no rule switches anything until the rule set is loaded again
+    void suspend();
+    bool isSuspended() const { return suspended; }
+    void setActuationCallback(void (*callback)(int)) { actuationCallback = callback; }
+
+    static const int MAX_RULES = 8;
+
+private:
+    struct Rule
+    {
+        uint8_t relay;
+        uint8_t sensor;
+        float onThreshold;
+        float offThreshold;
+        unsigned long maxRuntimeMs; // 0 = unlimited
+        unsigned long cooldownMs;
+        bool active;
+        unsigned long startedAt;
+        unsigned long stoppedAt;
+    };
+
+    static float sensorValue(const SensorReading &reading, uint8_t sensor);
+    void switchRule(Rule &rule, bool on, unsigned long now, const char *reason);
+
+    RelayController *relayController = nullptr;
+    Rule rules[MAX_RULES];
+    int ruleCount = 0;
+    bool suspended = false;
+    void (*actuationCallback)(int) = nullptr;
+};
+
+extern RuleEngine ruleEngine; // Declaration only
+
+#endif
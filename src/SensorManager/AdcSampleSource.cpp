@@ -0,0 +1,105 @@
+#include "AdcSampleSource.h"
+#if ESP_IDF_VERSION_MAJOR < 5
+#include <driver/adc.h>
+#endif
+
+volatile uint32_t AdcSampleSource::flowPulses = 0;
+
+void IRAM_ATTR AdcSampleSource::onFlowPulse()
+{
+    flowPulses++;
+}
+
+bool AdcSampleSource::begin()
+{
+    pinMode(FLOW_PIN, INPUT);
+    attachInterrupt(digitalPinToInterrupt(FLOW_PIN), onFlowPulse, FALLING);
+
+#if ESP_IDF_VERSION_MAJOR < 5
+    adc_digi_init_config_t initConfig = {};
+    initConfig.max_store_buf_size = 4096;
+    initConfig.conv_num_each_intr = sizeof(dmaBuffer);
+    initConfig.adc1_chan_mask = BIT(ADC1_CHANNEL_0) | BIT(ADC1_CHANNEL_6);
+    initConfig.adc2_chan_mask = 0;
+    if (adc_digi_initialize(&initConfig) != ESP_OK)
+    {
+        Serial.println("❌ ADC DMA init failed");
+        return false;
+    }
+
+    adc_digi_pattern_config_t pattern[2] = {};
+    const adc_channel_t channels[2] = {(adc_channel_t)ADC1_CHANNEL_0, (adc_channel_t)ADC1_CHANNEL_6};
+    for (int i = 0; i < 2; i++)
+    {
+        pattern[i].atten = ADC_ATTEN_DB_11;
+        pattern[i].channel = channels[i];
+        pattern[i].unit = 0; // ADC1
+        pattern[i].bit_width = SOC_ADC_DIGI_MAX_BITWIDTH;
+    }
+
+    adc_digi_configuration_t digitalConfig = {};
+    digitalConfig.conv_limit_en = true;
+    digitalConfig.conv_limit_num = 250;
+    digitalConfig.pattern_num = 2;
+    digitalConfig.adc_pattern = pattern;
+    digitalConfig.sample_freq_hz = ADC_SAMPLE_RATE_HZ;
+    digitalConfig.conv_mode = ADC_CONV_SINGLE_UNIT_1;
+    digitalConfig.format = ADC_DIGI_OUTPUT_FORMAT_TYPE1;
+    adc_digi_controller_configure(&digitalConfig);
+    dmaRunning = adc_digi_start() == ESP_OK;
+#endif
+
+    Serial.println(dmaRunning ? "🌡️ Sensors: ADC continuous mode" : "🌡️ Sensors: ADC one-shot mode");
+    return true;
+}
+
+int AdcSampleSource::readSamples(RawSample *samples, int maxSamples)
+{
+    int count = 0;
+
+#if ESP_IDF_VERSION_MAJOR < 5
+    if (dmaRunning)
+    {
+        uint32_t bytesRead = 0;
+        while (count < maxSamples &&
+               adc_digi_read_bytes(dmaBuffer, sizeof(dmaBuffer), &bytesRead, 0) == ESP_OK && bytesRead > 0)
+        {
+            for (uint32_t i = 0; i + SOC_ADC_DIGI_RESULT_BYTES <= bytesRead && count < maxSamples;
+                 i += SOC_ADC_DIGI_RESULT_BYTES)
+            {
+                adc_digi_output_data_t *result = (adc_digi_output_data_t *)&dmaBuffer[i];
+                if (result->type1.channel == ADC1_CHANNEL_0)
+                    samples[count].channel = SENSOR_SOIL_MOISTURE;
+                else if (result->type1.channel == ADC1_CHANNEL_6)
+                    samples[count].channel = SENSOR_TEMPERATURE;
+                else
+                    continue;
+                samples[count].value = result->type1.data;
+                count++;
+            }
+        }
+        return count;
+    }
+#endif
+
+    // No continuous driver on this core: take a short burst of one-shot reads instead
+    for (int i = 0; i < 8 && count + 1 < maxSamples; i++)
+    {
+        samples[count].channel = SENSOR_SOIL_MOISTURE;
+        samples[count].value = analogRead(MOISTURE_PIN);
+        count++;
+        samples[count].channel = SENSOR_TEMPERATURE;
+        samples[count].value = analogRead(TEMPERATURE_PIN);
+        count++;
+    }
+    return count;
+}
+
+uint32_t AdcSampleSource::takeFlowPulses()
+{
+    noInterrupts();
+    uint32_t pulses = flowPulses;
+    flowPulses = 0;
+    interrupts();
+    return pulses;
+}
@@ -0,0 +1,32 @@
+#ifndef ADC_SAMPLE_SOURCE_H
+#define ADC_SAMPLE_SOURCE_H
+
+#include <Arduino.h>
+#include "SampleSource.h"
+
+// ADC1 in continuous (DMA) mode plus an interrupt-counted flow meter.
+// Soil moisture probe on GPIO36, NTC thermistor divider on GPIO34, flow meter on GPIO39
+// (input-only pins not used by relays; GPIO39 needs an external pull-up).
+class AdcSampleSource : public SampleSource
+{
+public:
+    bool begin() override;
+    int readSamples(RawSample *samples, int maxSamples) override;
+    uint32_t takeFlowPulses() override;
+
+    static const int MOISTURE_PIN = 36;    // ADC1_CH0
+    static const int TEMPERATURE_PIN = 34; // ADC1_CH6
+    static const int FLOW_PIN = 39;
+    static bool usesPin(int pin) { return pin == MOISTURE_PIN || pin == TEMPERATURE_PIN || pin == FLOW_PIN; }
+    // Low rate plus a 4 KB DMA store holds ~2 s of samples, longer than the loop ever sleeps
+    static const uint32_t ADC_SAMPLE_RATE_HZ = 1000;
+
+private:
+    static void IRAM_ATTR onFlowPulse();
+    static volatile uint32_t flowPulses;
+
+    bool dmaRunning = false;
+    uint8_t dmaBuffer[256];
+};
+
+#endif
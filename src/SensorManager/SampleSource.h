@@ -0,0 +1,32 @@
+#ifndef SAMPLE_SOURCE_H
+#define SAMPLE_SOURCE_H
+
+#include <stdint.h>
+
+enum SensorChannel
+{
+    SENSOR_SOIL_MOISTURE = 0,
+    SENSOR_TEMPERATURE = 1,
+    SENSOR_CHANNEL_COUNT = 2
+};
+
+struct RawSample
+{
+    uint8_t channel; // SensorChannel
+    uint16_t value;  // 12-bit ADC reading
+};
+
+// Where SensorManager gets its raw data from: the ADC in DMA mode on the device,
+// or a deterministic generator on the native/simulated build.
+class SampleSource
+{
+public:
+    virtual ~SampleSource() {}
+    virtual bool begin() = 0;
+    // Drains whatever raw samples are ready without blocking; returns how many were written
+    virtual int readSamples(RawSample *samples, int maxSamples) = 0;
+    // Flow-meter pulses counted since the previous call
+    virtual uint32_t takeFlowPulses() = 0;
+};
+
+#endif
@@ -0,0 +1,163 @@
+#include "SensorManager.h"
+#include "Clock/Clock.h"
+
+SensorManager sensorManager;
+
+void SensorManager::initialize(SampleSource &sampleSource, unsigned long sampleIntervalMs, unsigned long batchIntervalMs)
+{
+    source = &sampleSource;
+    memset(filters, 0, sizeof(filters));
+    setIntervals(sampleIntervalMs, batchIntervalMs);
+    source->begin();
+    lastSample = systemClock().now();
+    clearBatch(lastSample);
+    Serial.println("🌱 Sensors sampling every " + String(sampleInterval) + " ms, batch every " +
+                   String(batchInterval) + " ms");
+}
+
+void SensorManager::setIntervals(unsigned long sampleIntervalMs, unsigned long batchIntervalMs)
+{
+    sampleInterval = max(sampleIntervalMs, 50UL);
+    batchInterval = max(batchIntervalMs, sampleInterval);
+}
+
+unsigned long SensorManager::getMillisUntilNextSample(unsigned long now) const
+{
+    if (!source)
+        return ULONG_MAX;
+    unsigned long elapsed = now - lastSample;
+    return elapsed >= sampleInterval ? 0 : sampleInterval - elapsed;
+}
+
+void SensorManager::loop()
+{
+    if (!source)
+        return;
+
+    // Keep draining the DMA buffer between samples so it never overflows
+    int count = source->readSamples(rawSamples, OVERSAMPLE_BUFFER);
+    for (int i = 0; i < count; i++)
+    {
+        if (rawSamples[i].channel < SENSOR_CHANNEL_COUNT)
+        {
+            filters[rawSamples[i].channel].sum += rawSamples[i].value;
+            filters[rawSamples[i].channel].count++;
+        }
+    }
+
+    unsigned long now = systemClock().now();
+    unsigned long elapsed = now - lastSample;
+    if (elapsed < sampleInterval)
+        return;
+    lastSample = now;
+
+    latest.timestamp = now;
+    latest.soilMoisture = moistureFromRaw(filterChannel(filters[SENSOR_SOIL_MOISTURE]));
+    latest.temperature = temperatureFromRaw(filterChannel(filters[SENSOR_TEMPERATURE]));
+    latest.flowRate = source->takeFlowPulses() / FLOW_PULSES_PER_LITRE * (60000.0f / elapsed);
+
+    if (batchCount < MAX_BATCH)
+    {
+        if (batchCount == 0)
+            batchFirstTimestamp = now;
+        batchMoisture[batchCount] = (int16_t)(latest.soilMoisture * 10);
+        batchTemperature[batchCount] = (int16_t)(latest.temperature * 10);
+        batchFlow[batchCount] = (int16_t)(latest.flowRate * 100);
+        batchCount++;
+    }
+
+    if (sampleCallback)
+        sampleCallback(latest);
+}
+
+// Oversampled mean -> median of the last readings -> exponential moving average
+float SensorManager::filterChannel(ChannelFilter &filter)
+{
+    if (filter.count > 0)
+    {
+        filter.window[filter.windowNext] = filter.sum / filter.count;
+        filter.windowNext = (filter.windowNext + 1) % MEDIAN_WINDOW;
+        if (filter.windowFill < MEDIAN_WINDOW)
+            filter.windowFill++;
+        filter.sum = 0;
+        filter.count = 0;
+    }
+    if (filter.windowFill == 0)
+        return filter.ema;
+
+    uint16_t sorted[MEDIAN_WINDOW];
+    memcpy(sorted, filter.window, sizeof(sorted));
+    for (int i = 1; i < filter.windowFill; i++)
+    {
+        uint16_t value = sorted[i];
+        int j = i - 1;
+        while (j >= 0 && sorted[j] > value)
+        {
+            sorted[j + 1] = sorted[j];
+            j--;
+        }
+        sorted[j + 1] = value;
+    }
+    float median = sorted[filter.windowFill / 2];
+
+    if (!filter.primed)
+    {
+        filter.ema = median;
+        filter.primed = true;
+    }
+    else
+    {
+        filter.ema += EMA_ALPHA * (median - filter.ema);
+    }
+    return filter.ema;
+}
+
+float SensorManager::moistureFromRaw(float raw)
+{
+    float percent = (MOISTURE_DRY_RAW - raw) * 100.0f / (MOISTURE_DRY_RAW - MOISTURE_WET_RAW);
+    return constrain(percent, 0.0f, 100.0f);
+}
+
+float SensorManager::temperatureFromRaw(float raw)
+{
+    // 10k NTC (beta 3950) on the low side of a 10k divider from 3.3 V
+    if (raw <= 0.0f || raw >= 4095.0f)
+        return 0.0f;
+    float resistance = 10000.0f * raw / (4095.0f - raw);
+    float kelvin = 1.0f / (1.0f / 298.15f + logf(resistance / 10000.0f) / 3950.0f);
+    return kelvin - 273.15f;
+}
+
+bool SensorManager::isBatchReady(unsigned long now) const
+{
+    // A full batch goes out early, unless it is already waiting out a failed publish
+    return (batchCount >= MAX_BATCH && !batchDeferred) || (batchCount > 0 && now - batchStart >= batchInterval);
+}
+
+void SensorManager::fillTelemetry(JsonDocument &doc) const
+{
+    doc["t0"] = batchFirstTimestamp;
+    doc["dt"] = sampleInterval;
+    JsonArray moisture = doc["m"].to<JsonArray>();
+    JsonArray temperature = doc["t"].to<JsonArray>();
+    JsonArray flow = doc["f"].to<JsonArray>();
+    for (int i = 0; i < batchCount; i++)
+    {
+        moisture.add(batchMoisture[i]);
+        temperature.add(batchTemperature[i]);
+        flow.add(batchFlow[i]);
+    }
+}
+
+void SensorManager::clearBatch(unsigned long now)
+{
+    batchCount = 0;
+    batchStart = now;
+    batchDeferred = false;
+}
+
+void SensorManager::deferBatch(unsigned long now)
+{
+    batchStart = now;
+    batchDeferred = true;
+}
@@ -0,0 +1,81 @@
+#ifndef SENSOR_MANAGER_H
+#define SENSOR_MANAGER_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include "SampleSource.h"
+
+struct SensorReading
+{
+    unsigned long timestamp;
+    float soilMoisture; // percent, 0 = dry probe, 100 = in water
+    float temperature;  // °C
+    float flowRate;     // litres per minute
+};
+
+class SensorManager
+{
+public:
+    void initialize(SampleSource &sampleSource, unsigned long sampleIntervalMs, unsigned long batchIntervalMs);
+    void setIntervals(unsigned long sampleIntervalMs, unsigned long batchIntervalMs);
+    void loop();
+    unsigned long getMillisUntilNextSample(unsigned long now) const;
+
+    // Called with every filtered reading, e.g. for local control rules
+    void setSampleCallback(void (*callback)(const SensorReading &)) { sampleCallback = callback; }
+    const SensorReading &getLatestReading() const { return latest; }
+
+    // Telemetry batching: one compact publish per batch interval
+    bool isBatchReady(unsigned long now) const;
+    void fillTelemetry(JsonDocument &doc) const;
+    void clearBatch(unsigned long now);
+    // Keeps the samples after a failed publish; the next attempt is one batch interval later
+    void deferBatch(unsigned long now);
+
+    static const int MAX_BATCH = 120;
+    static const int OVERSAMPLE_BUFFER = 256;
+    static const int MEDIAN_WINDOW = 5;
+
+private:
+    struct ChannelFilter
+    {
+        uint32_t sum;
+        uint32_t count;
+        uint16_t window[MEDIAN_WINDOW];
+        int windowFill;
+        int windowNext;
+        float ema;
+        bool primed;
+    };
+
+    float filterChannel(ChannelFilter &filter);
+    static float moistureFromRaw(float raw);
+    static float temperatureFromRaw(float raw);
+
+    SampleSource *source = nullptr;
+    ChannelFilter filters[SENSOR_CHANNEL_COUNT];
+    RawSample rawSamples[OVERSAMPLE_BUFFER];
+    SensorReading latest = {};
+    void (*sampleCallback)(const SensorReading &) = nullptr;
+
+    unsigned long sampleInterval = 1000;
+    unsigned long batchInterval = 60000;
+    unsigned long lastSample = 0;
+    unsigned long batchStart = 0;
+
+    int16_t batchMoisture[MAX_BATCH]; // 0.1 %
+    int16_t batchTemperature[MAX_BATCH]; // 0.1 °C
+    int16_t batchFlow[MAX_BATCH]; // 0.01 L/min
+    unsigned long batchFirstTimestamp = 0;
+    int batchCount = 0;
+    bool batchDeferred = false;
+
+    static constexpr float EMA_ALPHA = 0.3f;
+    static constexpr float FLOW_PULSES_PER_LITRE = 450.0f; // YF-S201 style hall sensor
+    static constexpr float MOISTURE_DRY_RAW = 3000.0f;
+    static constexpr float MOISTURE_WET_RAW = 1200.0f;
+};
+
+extern SensorManager sensorManager; // Declaration only
+
+#endif
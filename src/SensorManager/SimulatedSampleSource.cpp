@@ -0,0 +1,46 @@
+#include "SimulatedSampleSource.h"
+
+bool SimulatedSampleSource::begin()
+{
+    reads = 0;
+    return true;
+}
+
+uint16_t SimulatedSampleSource::noise()
+{
+    // xorshift32, so runs are reproducible
+    rngState ^= rngState << 13;
+    rngState ^= rngState >> 17;
+    rngState ^= rngState << 5;
+    return rngState % 32;
+}
+
+int SimulatedSampleSource::readSamples(RawSample *samples, int maxSamples)
+{
+    int count = 0;
+    reads++;
+
+    // Soil dries (raw rises) unless water is flowing
+    if (flowPerRead > 0 && moistureRaw > 1200)
+        moistureRaw -= 4;
+    else if (moistureRaw < 3000 && reads % 8 == 0)
+        moistureRaw++;
+    if (reads % 64 == 0)
+        temperatureRaw = temperatureRaw >= 2300 ? 1900 : temperatureRaw + 1;
+
+    for (int i = 0; i < 8 && count + 1 < maxSamples; i++)
+    {
+        samples[count].channel = SENSOR_SOIL_MOISTURE;
+        samples[count].value = moistureRaw + noise() - 16;
+        count++;
+        samples[count].channel = SENSOR_TEMPERATURE;
+        samples[count].value = temperatureRaw + noise() - 16;
+        count++;
+    }
+    return count;
+}
+
+uint32_t SimulatedSampleSource::takeFlowPulses()
+{
+    return flowPerRead;
+}
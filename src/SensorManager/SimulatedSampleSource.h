@@ -0,0 +1,30 @@
+#ifndef SIMULATED_SAMPLE_SOURCE_H
+#define SIMULATED_SAMPLE_SOURCE_H
+
+#include "SampleSource.h"
+
+// Deterministic stand-in for the ADC and flow meter. It has no Arduino dependencies, so it
+// also runs on a host build. Soil moisture dries out slowly and jumps back up while flow
+// pulses are being generated; temperature follows a slow ramp with noise.
+class SimulatedSampleSource : public SampleSource
+{
+public:
+    bool begin() override;
+    int readSamples(RawSample *samples, int maxSamples) override;
+    uint32_t takeFlowPulses() override;
+
+    // Test hooks
+    void setMoistureRaw(uint16_t raw) { moistureRaw = raw; }
+    void setFlowPulsesPerRead(uint32_t pulses) { flowPerRead = pulses; }
+
+private:
+    uint16_t noise();
+
+    uint32_t rngState = 0x12345678;
+    uint16_t moistureRaw = 2000;
+    uint16_t temperatureRaw = 2048;
+    uint32_t reads = 0;
+    uint32_t flowPerRead = 0;
+};
+
+#endif
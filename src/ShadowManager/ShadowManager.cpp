@@ -0,0 +1,178 @@
+#include "ShadowManager.h"
+#include "Clock/Clock.h"
+
+ShadowManager shadowManager;
+
+static const uint32_t ALL_RELAYS = (1UL << RelayController::RELAY_COUNT) - 1;
+
+void ShadowManager::initialize(RelayController &relays, PreferencesManager &prefs, ProgramRunner &programs)
+{
+    relayController = &relays;
+    preferences = &prefs;
+    programRunner = &programs;
+    appliedVersion = preferences->getShadowVersion();
+}
+
+bool ShadowManager::setDesired(const byte *payload, unsigned int length, String &error)
+{
+    // Deleting the retained document stops reconciliation; relays stay as they are
+    if (length == 0)
+    {
+        desiredValid = false;
+        reportPending = true;
+        Serial.println("🪞 Desired state cleared");
+        return true;
+    }
+
+    JsonDocument doc;
+    if (deserializeJson(doc, payload, length))
+    {
+        error = "invalid JSON";
+        return false;
+    }
+
+    unsigned long version = doc["version"] | 0UL;
+    uint32_t mask = doc["mask"] | 0UL;
+    if (version == 0 || (mask & ~ALL_RELAYS))
+    {
+        error = "version and a valid mask required";
+        return false;
+    }
+
+    uint32_t timed = 0;
+    unsigned long timers[RelayController::RELAY_COUNT] = {0};
+    for (JsonPairConst timer : doc["timers"].as<JsonObjectConst>())
+    {
+        const char *key = timer.key().c_str();
+        char *end;
+        long relay = strtol(key, &end, 10);
+        unsigned long seconds = timer.value() | 0UL;
+        if (*key == '\0' || *end != '\0' || relay < 0 || relay >= RelayController::RELAY_COUNT ||
+            !(mask & (1UL << relay)) || seconds == 0 || seconds > MAX_TIMER_S)
+        {
+            error = "invalid timer for relay " + String(key);
+            return false;
+        }
+        timed |= (1UL << relay);
+        timers[relay] = seconds;
+    }
+
+    // A newer document takes back the relays switched locally under the previous one
+    if (!desiredValid || version != desiredVersion)
+        heldMask = 0;
+    desiredVersion = version;
+    desiredMask = mask;
+    timedMask = timed;
+    for (int i = 0; i < RelayController::RELAY_COUNT; i++)
+        timerS[i] = timers[i];
+    desiredValid = true;
+    reconcile();
+    return true;
+}
+
+// Steady relays that differ from the document. A running timer or pulse pattern also
+// counts as a difference: the document asks for a steady level.
+uint32_t ShadowManager::getDelta(const RelaySnapshot &snapshot) const
+{
+    uint32_t delta = 0;
+    for (int i = 0; i < RelayController::RELAY_COUNT; i++)
+    {
+        uint32_t bit = 1UL << i;
+        if (timedMask & bit)
+            continue;
+        bool wanted = desiredMask & bit;
+        if (snapshot.states[i] != wanted || snapshot.timers[i] != 0 || snapshot.isPulsing(i))
+            delta |= bit;
+    }
+    return delta;
+}
+
+uint32_t ShadowManager::getHeldMask() const
+{
+    return heldMask | programRunner->getHeldMask();
+}
+
+void ShadowManager::reconcile()
+{
+    RelaySnapshot snapshot;
+    relayController->getSnapshot(snapshot);
+    uint32_t delta = getDelta(snapshot);
+    uint32_t held = getHeldMask();
+    uint32_t skippedMask = delta & held;
+    delta &= ~held;
+    int switched = 0;
+    for (int i = 0; i < RelayController::RELAY_COUNT && delta; i++)
+    {
+        if (delta & (1UL << i))
+        {
+            relayController->forceRelay(i, (desiredMask & (1UL << i)) != 0);
+            switched++;
+        }
+    }
+
+    // Timers run once per version, so a document replayed after a reconnect or reboot
+    // does not water a zone a second time
+    if (desiredVersion != appliedVersion)
+    {
+        for (int i = 0; i < RelayController::RELAY_COUNT; i++)
+        {
+            if ((timedMask & ~held) & (1UL << i))
+            {
+                relayController->setRelayTimer(i, timerS[i]);
+                switched++;
+            }
+        }
+        appliedVersion = desiredVersion;
+        preferences->setShadowVersion(appliedVersion);
+    }
+
+    int skippedCount = 0;
+    for (uint32_t bits = skippedMask; bits; bits &= bits - 1)
+        skippedCount++;
+    corrections += switched;
+    skipped += skippedCount;
+    reportPending = true;
+    Serial.println("🪞 Desired state v" + String(desiredVersion) + " applied, " + String(switched) +
+                   " relay(s) switched, " + String(skippedCount) + " held locally");
+}
+
+bool ShadowManager::isReportDue(uint32_t stateVersion) const
+{
+    return reportPending || (desiredValid && stateVersion != reportedStateVersion);
+}
+
+void ShadowManager::fillReported(JsonDocument &doc, const RelaySnapshot &snapshot, unsigned long now) const
+{
+    uint32_t mask = 0;
+    JsonObject timers = doc["timers"].to<JsonObject>();
+    for (int i = 0; i < RelayController::RELAY_COUNT; i++)
+    {
+        if (snapshot.states[i])
+            mask |= (1UL << i);
+        if (snapshot.timers[i] != 0)
+            timers[String(i)] = Clock::getRemaining(now, snapshot.timers[i]) / 1000;
+    }
+
+    doc["mask"] = mask;
+    doc["pulsingMask"] = snapshot.pulsingMask;
+    doc["version"] = snapshot.version;
+    if (desiredValid)
+    {
+        doc["desiredVersion"] = desiredVersion;
+        doc["deltaMask"] = getDelta(snapshot);
+        doc["heldMask"] = getHeldMask();
+    }
+}
+
+void ShadowManager::markReported(uint32_t stateVersion)
+{
+    reportPending = false;
+    reportedStateVersion = stateVersion;
+}
+
+void ShadowManager::fillMetrics(JsonObject metrics) const
+{
+    metrics["desiredVersion"] = desiredValid ? desiredVersion : 0;
+    metrics["corrections"] = corrections;
+    metrics["skipped"] = skipped;
+}
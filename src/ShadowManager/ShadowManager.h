@@ -0,0 +1,67 @@
+#ifndef SHADOW_MANAGER_H
+#define SHADOW_MANAGER_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include "RelayController/RelayController.h"
+#include "PreferencesManager/PreferencesManager.h"
+#include "ProgramRunner/ProgramRunner.h"
+
+// Desired-state reconciliation. The backend keeps one retained document per device on
+// green-tech/<deviceId>/desired instead of sending imperative commands:
+//
+//   {"version": 12, "mask": 41, "timers": {"3": 600}}
+//
+// mask holds the relays that should be on; a relay listed in timers runs for that many
+// seconds once per version instead of staying on. On every delivery (the broker replays
+// the retained document after each reconnect) only relays that differ from the document
+// are switched, so redelivery is harmless and a reconnect needs no corrective commands.
+// The reported state and the remaining delta go back retained on .../reported.
+//
+// Local control wins over the document. Relays of an active program are never
+// reconciled, and a relay switched by a manual input or a rule is held until a newer
+// version arrives. Held relays that differ stay in deltaMask.
+class ShadowManager
+{
+public:
+    void initialize(RelayController &relays, PreferencesManager &prefs, ProgramRunner &programs);
+    // Call from loop() context (the MQTT callback); an empty payload clears the document
+    bool setDesired(const byte *payload, unsigned int length, String &error);
+    bool hasDesired() const { return desiredValid; }
+    // Relays switched locally; reconciliation leaves them alone until the next version
+    void holdRelays(uint32_t mask) { heldMask |= mask; }
+
+    // True when the relays changed since the last report, or a document was applied
+    bool isReportDue(uint32_t stateVersion) const;
+    void fillReported(JsonDocument &doc, const RelaySnapshot &snapshot, unsigned long now) const;
+    void markReported(uint32_t stateVersion);
+    void fillMetrics(JsonObject metrics) const;
+
+    static const unsigned long MAX_TIMER_S = 86400;
+
+private:
+    void reconcile();
+    uint32_t getDelta(const RelaySnapshot &snapshot) const;
+    uint32_t getHeldMask() const;
+
+    RelayController *relayController = nullptr;
+    PreferencesManager *preferences = nullptr;
+    ProgramRunner *programRunner = nullptr;
+
+    bool desiredValid = false;
+    unsigned long desiredVersion = 0;
+    uint32_t desiredMask = 0;
+    uint32_t timedMask = 0;          // Relays run by timer; never forced after their version applied
+    unsigned long timerS[RelayController::RELAY_COUNT] = {0};
+    unsigned long appliedVersion = 0;
+    uint32_t heldMask = 0;           // Switched locally since desiredVersion arrived
+
+    bool reportPending = false;
+    uint32_t reportedStateVersion = 0;
+    uint32_t corrections = 0;        // Relays switched by reconciliation since boot
+    uint32_t skipped = 0;            // Differing relays left alone because local control held them
+};
+
+extern ShadowManager shadowManager; // Declaration only
+
+#endif
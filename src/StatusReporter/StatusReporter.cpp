@@ -0,0 +1,114 @@
+#include "StatusReporter.h"
+
+StatusReporter statusReporter;
+
+void StatusReporter::initialize(RelayController &relays, MQTTManager &mqtt, unsigned long heartbeatIntervalMs)
+{
+    relayController = &relays;
+    mqttManager = &mqtt;
+    this->heartbeatIntervalMs = heartbeatIntervalMs;
+}
+
+bool StatusReporter::loop(unsigned long now)
+{
+    if (!mqttManager->isConnected() || !baselineValid)
+        return false;
+
+    RelaySnapshot current;
+    relayController->getSnapshot(current);
+
+    // The window opens at the first change and is not extended, bounding report latency
+    if (!deltaPending && current.version != reported.version)
+    {
+        deltaPending = true;
+        changeSeenAt = now;
+    }
+    if (deltaPending && now - changeSeenAt >= DEBOUNCE_MS)
+        sendDelta(current);
+
+    if (now - lastHeartbeat >= heartbeatIntervalMs)
+    {
+        mqttManager->sendHeartbeat(reported.version);
+        lastHeartbeat = now;
+        heartbeatsSent++;
+        return true;
+    }
+    return false;
+}
+
+void StatusReporter::flush()
+{
+    if (!mqttManager->isConnected() || !baselineValid)
+        return;
+
+    RelaySnapshot current;
+    relayController->getSnapshot(current);
+    if (current.version != reported.version)
+        sendDelta(current);
+}
+
+void StatusReporter::sendDelta(const RelaySnapshot &current)
+{
+    JsonDocument doc;
+    doc["from"] = reported.version;
+    doc["version"] = current.version;
+    JsonArray relays = doc["relays"].to<JsonArray>();
+    for (int i = 0; i < RelayController::RELAY_COUNT; i++)
+    {
+        if (current.states[i] == reported.states[i] && current.timers[i] == reported.timers[i] &&
+            current.isPulsing(i) == reported.isPulsing(i))
+            continue;
+
+        JsonObject relay = relays.add<JsonObject>();
+        relay["index"] = i;
+        relay["state"] = current.states[i];
+        relay["timer"] = current.timers[i];
+        if (current.isPulsing(i))
+            relay["pulsing"] = true;
+    }
+
+    if (mqttManager->sendStatusDelta(doc))
+    {
+        reported = current;
+        deltaPending = false;
+        deltasSent++;
+    }
+}
+
+void StatusReporter::sendSnapshot(unsigned long now)
+{
+    RelaySnapshot current;
+    relayController->getSnapshot(current);
+    if (!mqttManager->sendDeviceStatus(current))
+        return;
+
+    reported = current;
+    baselineValid = true;
+    deltaPending = false;
+    // The snapshot carries everything a heartbeat would
+    lastHeartbeat = now;
+    snapshotsSent++;
+}
+
+unsigned long StatusReporter::getMillisUntilDue(unsigned long now) const
+{
+    if (!baselineValid)
+        return ULONG_MAX;
+
+    unsigned long elapsed = now - lastHeartbeat;
+    unsigned long wait = elapsed >= heartbeatIntervalMs ? 0 : heartbeatIntervalMs - elapsed;
+    if (deltaPending)
+    {
+        elapsed = now - changeSeenAt;
+        wait = min(wait, elapsed >= DEBOUNCE_MS ? 0 : DEBOUNCE_MS - elapsed);
+    }
+    return wait;
+}
+
+void StatusReporter::fillMetrics(JsonObject metrics)
+{
+    metrics["deltas"] = deltasSent;
+    metrics["snapshots"] = snapshotsSent;
+    metrics["heartbeats"] = heartbeatsSent;
+    metrics["heartbeatMs"] = heartbeatIntervalMs;
+}
@@ -0,0 +1,50 @@
+#ifndef STATUS_REPORTER_H
+#define STATUS_REPORTER_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include "RelayController/RelayController.h"
+#include "MQTTManager/MQTTManager.h"
+
+// Change-driven status reporting. Relay changes are published as deltas against the last
+// reported state, debounced so a burst of commands yields one message. A sparse heartbeat
+// proves liveness while nothing changes; full snapshots go out only on reconnect or request.
+class StatusReporter
+{
+public:
+    void initialize(RelayController &relays, MQTTManager &mqtt, unsigned long heartbeatIntervalMs);
+    void setHeartbeatInterval(unsigned long intervalMs) { heartbeatIntervalMs = intervalMs; }
+
+    // Call every pass; publishes a due delta or heartbeat. Returns true if a heartbeat went out.
+    bool loop(unsigned long now);
+    // Publishes a pending delta immediately, e.g. after an emergency stop
+    void flush();
+    // Full device status; also becomes the baseline for the next delta
+    void sendSnapshot(unsigned long now);
+    unsigned long getMillisUntilDue(unsigned long now) const;
+
+    void fillMetrics(JsonObject metrics);
+
+    static const unsigned long DEBOUNCE_MS = 250;
+    static const unsigned long DEFAULT_HEARTBEAT_MS = 300000;
+
+private:
+    void sendDelta(const RelaySnapshot &current);
+
+    RelayController *relayController = nullptr;
+    MQTTManager *mqttManager = nullptr;
+    RelaySnapshot reported; // What the backend last heard about
+    bool baselineValid = false;
+    bool deltaPending = false;
+    unsigned long changeSeenAt = 0;
+    unsigned long lastHeartbeat = 0;
+    unsigned long heartbeatIntervalMs = DEFAULT_HEARTBEAT_MS;
+
+    uint32_t deltasSent = 0;
+    uint32_t snapshotsSent = 0;
+    uint32_t heartbeatsSent = 0;
+};
+
+extern StatusReporter statusReporter; // Declaration only
+
+#endif
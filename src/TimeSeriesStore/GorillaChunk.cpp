@@ -0,0 +1,118 @@
+#include "GorillaChunk.h"
+#include <string.h>
+
+void GorillaChunk::reset(uint32_t sequence, uint32_t bootId, uint32_t startTime)
+{
+    memset(buffer, 0, sizeof(buffer));
+    memset(series, 0, sizeof(series));
+    Header &h = mutableHeader();
+    h.magic = MAGIC;
+    h.sequence = sequence;
+    h.bootId = bootId;
+    h.startTime = startTime;
+}
+
+bool GorillaChunk::append(uint8_t seriesId, uint32_t timestamp, uint32_t value)
+{
+    if (seriesId >= MAX_SERIES || (size_t)mutableHeader().bitCount + MAX_RECORD_BITS > PAYLOAD_BITS)
+        return false;
+
+    SeriesState &state = series[seriesId];
+    writeBits(seriesId, 3);
+    writeTimestamp(state, timestamp);
+    writeValue(state, value);
+    state.seen = true;
+    mutableHeader().recordCount++;
+    return true;
+}
+
+void GorillaChunk::writeBits(uint32_t value, int bits)
+{
+    uint8_t *payload = buffer + sizeof(Header);
+    Header &h = mutableHeader();
+    for (int i = bits - 1; i >= 0; i--)
+    {
+        if (value & (1UL << i))
+            payload[h.bitCount >> 3] |= 0x80 >> (h.bitCount & 7);
+        h.bitCount++;
+    }
+}
+
+void GorillaChunk::writeTimestamp(SeriesState &state, uint32_t timestamp)
+{
+    if (!state.seen)
+    {
+        writeBits(timestamp, 32);
+        state.lastTimestamp = timestamp;
+        state.lastDelta = 0;
+        return;
+    }
+
+    int32_t delta = (int32_t)(timestamp - state.lastTimestamp);
+    int32_t dod = delta - state.lastDelta;
+    if (dod == 0)
+    {
+        writeBits(0, 1);
+    }
+    else if (dod >= -64 && dod <= 63)
+    {
+        writeBits(0b10, 2);
+        writeBits((uint32_t)dod & 0x7F, 7);
+    }
+    else if (dod >= -256 && dod <= 255)
+    {
+        writeBits(0b110, 3);
+        writeBits((uint32_t)dod & 0x1FF, 9);
+    }
+    else if (dod >= -2048 && dod <= 2047)
+    {
+        writeBits(0b1110, 4);
+        writeBits((uint32_t)dod & 0xFFF, 12);
+    }
+    else
+    {
+        writeBits(0b1111, 4);
+        writeBits((uint32_t)dod, 32);
+    }
+    state.lastTimestamp = timestamp;
+    state.lastDelta = delta;
+}
+
+void GorillaChunk::writeValue(SeriesState &state, uint32_t value)
+{
+    if (!state.seen)
+    {
+        writeBits(value, 32);
+        state.lastValue = value;
+        state.leading = 0xFF; // No window yet
+        return;
+    }
+
+    uint32_t xorValue = value ^ state.lastValue;
+    state.lastValue = value;
+    if (xorValue == 0)
+    {
+        writeBits(0, 1);
+        return;
+    }
+
+    uint8_t leading = __builtin_clz(xorValue);
+    uint8_t trailing = __builtin_ctz(xorValue);
+    if (leading > 31)
+        leading = 31; // Must fit in 5 bits
+
+    if (state.leading != 0xFF && leading >= state.leading && trailing >= state.trailing)
+    {
+        writeBits(0b10, 2);
+        writeBits(xorValue >> state.trailing, 32 - state.leading - state.trailing);
+        return;
+    }
+
+    uint8_t length = 32 - leading - trailing;
+    writeBits(0b11, 2);
+    writeBits(leading, 5);
+    writeBits(length - 1, 6); // 1..32 stored as 0..31
+    writeBits(xorValue >> trailing, length);
+    state.leading = leading;
+    state.trailing = trailing;
+}
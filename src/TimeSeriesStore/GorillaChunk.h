@@ -0,0 +1,73 @@
+#ifndef GORILLA_CHUNK_H
+#define GORILLA_CHUNK_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// One self-contained, Gorilla-compressed block of time-series records.
+//
+// Layout: a 20 byte header followed by a bit stream, most significant bit first.
+// Each record is  series (3 bits) | timestamp | value,  with state kept per series:
+//   timestamp: first record of a series stores 32 raw bits; after that the
+//              delta-of-delta is coded as '0' | '10'+7 | '110'+9 | '1110'+12 | '1111'+32 bits
+//              (two's complement: -64..63, -256..255, -2048..2047, anything else)
+//   value:     first record stores 32 raw bits; after that XOR with the previous value:
+//              '0' equal | '10' + bits inside the previous window | '11' + 5 bit leading
+//              zeros + 6 bit length + meaningful bits
+// Values are raw 32-bit words: sensor readings as signed fixed point (0.1 units) and
+// relay states as bit masks. Slowly changing integers keep the XOR small.
+class GorillaChunk
+{
+public:
+    struct Header
+    {
+        uint16_t magic;
+        uint16_t bitCount;
+        uint32_t sequence;
+        uint32_t bootId;
+        uint32_t startTime;
+        uint16_t recordCount;
+        uint16_t reserved;
+    };
+
+    static const size_t SIZE = 1024;
+    static const int MAX_SERIES = 8;
+    static const uint16_t MAGIC = 0x4753; // "GS"
+
+    void reset(uint32_t sequence, uint32_t bootId, uint32_t startTime);
+    // Returns false when the chunk is full; the caller seals it and retries on a fresh one
+    bool append(uint8_t series, uint32_t timestamp, uint32_t value);
+
+    const uint8_t *data() const { return buffer; }
+    size_t size() const { return sizeof(Header) + (header().bitCount + 7) / 8; }
+    const Header &header() const { return *reinterpret_cast<const Header *>(buffer); }
+    bool isEmpty() const { return header().recordCount == 0; }
+    bool isValid() const { return header().magic == MAGIC; }
+    // Direct access for loading a persisted chunk back from flash (read-only use afterwards)
+    uint8_t *rawBuffer() { return buffer; }
+
+private:
+    struct SeriesState
+    {
+        bool seen;
+        uint32_t lastTimestamp;
+        int32_t lastDelta;
+        uint32_t lastValue;
+        uint8_t leading;
+        uint8_t trailing;
+    };
+
+    Header &mutableHeader() { return *reinterpret_cast<Header *>(buffer); }
+    void writeBits(uint32_t value, int bits);
+    void writeTimestamp(SeriesState &state, uint32_t timestamp);
+    void writeValue(SeriesState &state, uint32_t value);
+
+    // Worst case record: 3 + 4 + 32 + 2 + 5 + 6 + 32 bits
+    static const int MAX_RECORD_BITS = 84;
+    static const size_t PAYLOAD_BITS = (SIZE - sizeof(Header)) * 8;
+
+    alignas(4) uint8_t buffer[SIZE];
+    SeriesState series[MAX_SERIES];
+};
+
+#endif
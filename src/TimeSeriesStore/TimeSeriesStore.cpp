@@ -0,0 +1,190 @@
+#include "TimeSeriesStore.h"
+#include "Clock/Clock.h"
+#include <esp_system.h>
+
+TimeSeriesStore timeSeriesStore;
+
+static const uint32_t FLASH_SECTOR_SIZE = 4096;
+
+void TimeSeriesStore::initialize()
+{
+    bootId = esp_random();
+
+    flashPartition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, "history");
+    if (flashPartition)
+    {
+        flashSlots = flashPartition->size / GorillaChunk::SIZE;
+
+        // Continue after the newest persisted chunk so sequence numbers stay unique across boots
+        bool found = false;
+        uint32_t newest = 0;
+        for (uint32_t slot = 0; slot < flashSlots; slot++)
+        {
+            GorillaChunk::Header header;
+            if (esp_partition_read(flashPartition, slot * GorillaChunk::SIZE, &header, sizeof(header)) != ESP_OK ||
+                header.magic != GorillaChunk::MAGIC)
+                continue;
+            if (!found || (int32_t)(header.sequence - newest) > 0)
+            {
+                newest = header.sequence;
+                flashNextSlot = (slot + 1) % flashSlots;
+                found = true;
+            }
+        }
+        if (found)
+            nextSequence = newest + 1;
+        Serial.println("🗄️ History partition: " + String(flashSlots) + " chunks");
+    }
+
+    currentChunk = 0;
+    chunks[currentChunk].reset(nextSequence++, bootId, systemClock().now());
+}
+
+void TimeSeriesStore::append(uint8_t series, uint32_t value)
+{
+    uint32_t now = systemClock().now();
+    if (!chunks[currentChunk].append(series, now, value))
+    {
+        sealCurrentChunk();
+        chunks[currentChunk].append(series, now, value);
+    }
+}
+
+void TimeSeriesStore::sealCurrentChunk()
+{
+    persistChunk(chunks[currentChunk]);
+    // The oldest RAM chunk is overwritten; it is still on flash if a partition exists
+    currentChunk = (currentChunk + 1) % RAM_CHUNKS;
+    chunks[currentChunk].reset(nextSequence++, bootId, systemClock().now());
+}
+
+void TimeSeriesStore::persistChunk(const GorillaChunk &chunk)
+{
+    if (!flashPartition || flashSlots == 0)
+        return;
+
+    uint32_t offset = flashNextSlot * GorillaChunk::SIZE;
+    if (offset % FLASH_SECTOR_SIZE == 0)
+        esp_partition_erase_range(flashPartition, offset, FLASH_SECTOR_SIZE);
+    esp_partition_write(flashPartition, offset, chunk.data(), GorillaChunk::SIZE);
+    flashNextSlot = (flashNextSlot + 1) % flashSlots;
+}
+
+bool TimeSeriesStore::readFlashChunk(uint32_t slot, GorillaChunk &chunk)
+{
+    return esp_partition_read(flashPartition, slot * GorillaChunk::SIZE, chunk.rawBuffer(), GorillaChunk::SIZE) == ESP_OK &&
+           chunk.isValid();
+}
+
+void TimeSeriesStore::recordRelayStates(const bool *relayStates, int relayCount)
+{
+    uint32_t mask = 0;
+    for (int i = 0; i < relayCount && i < 32; i++)
+    {
+        if (relayStates[i])
+            mask |= (1UL << i);
+    }
+    if (relayMaskRecorded && mask == lastRelayMask)
+        return;
+
+    append(SERIES_RELAYS, mask);
+    lastRelayMask = mask;
+    relayMaskRecorded = true;
+}
+
+void TimeSeriesStore::recordReading(const SensorReading &reading)
+{
+    if (lastSensorRecord != 0 && reading.timestamp - lastSensorRecord < SENSOR_HISTORY_INTERVAL_MS)
+        return;
+    lastSensorRecord = reading.timestamp;
+
+    // Fixed point in 0.1 units: slowly changing integers XOR-compress far better than floats
+    append(SERIES_MOISTURE, (uint32_t)(int32_t)lroundf(reading.soilMoisture * 10));
+    append(SERIES_TEMPERATURE, (uint32_t)(int32_t)lroundf(reading.temperature * 10));
+    append(SERIES_FLOW, (uint32_t)(int32_t)lroundf(reading.flowRate * 10));
+}
+
+int TimeSeriesStore::getSealedChunkCount() const
+{
+    int count = 0;
+    for (int i = 0; i < RAM_CHUNKS; i++)
+    {
+        if (i != currentChunk && chunks[i].isValid())
+            count++;
+    }
+    return count;
+}
+
+void TimeSeriesStore::markLinkDown()
+{
+    if (linkDown)
+        return;
+    linkDown = true;
+    linkDownSequence = chunks[currentChunk].header().sequence;
+}
+
+void TimeSeriesStore::requestUploadSinceLinkDown()
+{
+    if (!linkDown)
+        return;
+    linkDown = false;
+    uploadFromFlash = false;
+    uploadCursor = linkDownSequence;
+    uploadEnd = chunks[currentChunk].header().sequence;
+    uploadPending = true;
+}
+
+void TimeSeriesStore::requestUpload(bool fromFlash)
+{
+    uploadFromFlash = fromFlash && flashPartition != nullptr;
+    if (uploadFromFlash)
+    {
+        uploadCursor = 0;
+        uploadEnd = flashSlots - 1;
+    }
+    else
+    {
+        // The slot after the open chunk holds the oldest sequence still in RAM
+        const GorillaChunk &oldest = chunks[(currentChunk + 1) % RAM_CHUNKS];
+        uploadCursor = oldest.isValid() ? oldest.header().sequence : chunks[0].header().sequence;
+        uploadEnd = chunks[currentChunk].header().sequence;
+    }
+    uploadPending = true;
+}
+
+bool TimeSeriesStore::takeNextUploadChunk(const uint8_t *&data, size_t &size, uint32_t &sequence)
+{
+    while (uploadPending && (int32_t)(uploadEnd - uploadCursor) >= 0)
+    {
+        uint32_t cursor = uploadCursor++;
+        const GorillaChunk *chunk = nullptr;
+
+        if (uploadFromFlash)
+        {
+            if (readFlashChunk(cursor, flashReadBuffer))
+                chunk = &flashReadBuffer;
+        }
+        else
+        {
+            for (int i = 0; i < RAM_CHUNKS; i++)
+            {
+                if (chunks[i].isValid() && chunks[i].header().sequence == cursor)
+                {
+                    chunk = &chunks[i];
+                    break;
+                }
+            }
+        }
+
+        if (chunk && !chunk->isEmpty())
+        {
+            data = chunk->data();
+            size = chunk->size();
+            sequence = chunk->header().sequence;
+            return true;
+        }
+    }
+
+    uploadPending = false;
+    return false;
+}
@@ -0,0 +1,70 @@
+#ifndef TIME_SERIES_STORE_H
+#define TIME_SERIES_STORE_H
+
+#include <Arduino.h>
+#include <esp_partition.h>
+#include "GorillaChunk.h"
+#include "SensorManager/SensorManager.h"
+
+// Ring of compressed chunks holding relay transitions and sensor history while the link
+// is down or slow. Sealed chunks are also copied to a "history" data partition when the
+// partition table has one, so history survives a reboot.
+class TimeSeriesStore
+{
+public:
+    enum Series
+    {
+        SERIES_RELAYS = 0,
+        SERIES_MOISTURE = 1,
+        SERIES_TEMPERATURE = 2,
+        SERIES_FLOW = 3
+    };
+
+    void initialize();
+    void recordRelayStates(const bool *relayStates, int relayCount);
+    void recordReading(const SensorReading &reading);
+
+    // Upload is paced one chunk per call so the loop never stalls on a large backlog
+    void requestUpload(bool fromFlash);
+    void requestUploadSinceLinkDown();
+    void markLinkDown();
+    bool hasPendingUpload() const { return uploadPending; }
+    bool takeNextUploadChunk(const uint8_t *&data, size_t &size, uint32_t &sequence);
+
+    uint32_t getBootId() const { return bootId; }
+    int getSealedChunkCount() const;
+
+    static const int RAM_CHUNKS = 32; // 32 KB: several days at the default history interval
+    static const unsigned long SENSOR_HISTORY_INTERVAL_MS = 60000;
+
+private:
+    void append(uint8_t series, uint32_t value);
+    void sealCurrentChunk();
+    void persistChunk(const GorillaChunk &chunk);
+    bool readFlashChunk(uint32_t slot, GorillaChunk &chunk);
+
+    GorillaChunk chunks[RAM_CHUNKS];
+    int currentChunk = 0;
+    uint32_t nextSequence = 0;
+    uint32_t bootId = 0;
+
+    uint32_t lastRelayMask = 0;
+    bool relayMaskRecorded = false;
+    unsigned long lastSensorRecord = 0;
+
+    const esp_partition_t *flashPartition = nullptr;
+    uint32_t flashSlots = 0;
+    uint32_t flashNextSlot = 0;
+
+    bool uploadPending = false;
+    bool uploadFromFlash = false;
+    uint32_t uploadCursor = 0;   // next sequence (RAM) or slot (flash) to send
+    uint32_t uploadEnd = 0;
+    uint32_t linkDownSequence = 0;
+    bool linkDown = false;
+    GorillaChunk flashReadBuffer;
+};
+
+extern TimeSeriesStore timeSeriesStore; // Declaration only
+
+#endif
@@ -1,119 +1,12 @@
 #include "WebInterface.h"
+#include "CommandTracer/CommandTracer.h"
+#include "RelayController/RelayController.h"
+#include "WiFiManager/WiFiManager.h"
 
 WebInterface webInterface;
 
-void WebInterface::initialize(PreferencesManager &prefs, MQTTManager &mqtt, Core &coreRef)
-{
-    preferences = &prefs;
-    mqttManager = &mqtt;
-    core = &coreRef;
-
-    server.on("/", std::bind(&WebInterface::handleRoot, this));
-    server.on("/scan", std::bind(&WebInterface::handleScan, this));
-    server.on("/configure", HTTP_POST, std::bind(&WebInterface::handleConfigure, this));
-    server.on("/test", HTTP_GET, std::bind(&WebInterface::handleTest, this));
-
-    server.begin();
-
-    Serial.println("✅ Web server started");
-    Serial.println("📍 Available endpoints:");
-    Serial.println("   - http://192.168.4.1/ (main page)");
-    Serial.println("   - http://192.168.4.1/scan (WiFi scan)");
-    Serial.println("   - http://192.168.4.1/configure (setup)");
-    Serial.println("   - http://192.168.4.1/test (debug)");
-}
-
-void WebInterface::handleClient()
-{
-    server.handleClient();
-}
-
-void WebInterface::handleRoot()
-{
-    Serial.println("📄 Serving main page to client");
-    server.send(200, "text/html", getMainPage());
-}
-
-void WebInterface::handleScan()
-{
-    Serial.println("📡 Handling WiFi scan request");
-    int numNetworks = WiFi.scanNetworks();
-
-    JsonDocument doc;
-    JsonArray networks = doc["networks"].to<JsonArray>();
-
-    for (int i = 0; i < numNetworks; i++)
-    {
-        networks.add(WiFi.SSID(i));
-    }
-
-    String response;
-    serializeJson(doc, response);
-    server.send(200, "application/json", response);
-
-    Serial.println("✅ Sent " + String(numNetworks) + " networks to client");
-}
-
-void WebInterface::handleTest()
-{
-    Serial.println("✅ Test endpoint accessed");
-    server.send(200, "text/plain", "Web server is working!");
-}
-
-void WebInterface::handleConfigure()
-{
-    if (server.method() == HTTP_POST)
-    {
-        String body = server.arg("plain");
-        JsonDocument doc;
-        deserializeJson(doc, body);
-
-        String ssid = doc["ssid"];
-        String password = doc["password"];
-        String username = doc["username"];
-        String user_password = doc["user_password"];
-
-        Serial.println("=== CONFIGURATION RECEIVED ===");
-        Serial.println("SSID: " + ssid);
-        Serial.println("Username: " + username);
-        Serial.println("========================");
-
-        // Save to preferences
-        preferences->setWiFiCredentials(ssid, password);
-        preferences->setSystemCredentials(username, user_password);
-        preferences->setConfigured(true);
-
-        // Don't try to send credentials here - it will happen after restart
-        // when WiFi and MQTT are properly connected
-        Serial.println("✅ Configuration saved successfully!");
-        Serial.println("🔃 Credentials will be sent to database after device restarts and connects to WiFi");
-
-        JsonDocument responseDoc;
-        responseDoc["success"] = true;
-        responseDoc["message"] = "Configuration saved successfully! Device will restart and connect to your network.";
-
-        String response;
-        serializeJson(responseDoc, response);
-        server.send(200, "application/json", response);
-
-        Serial.println("🔄 Restarting device in 3 seconds...");
-        delay(3000);
-        ESP.restart();
-    }
-}
-bool WebInterface::sendCredentialsToDatabase(const String &username, const String &password)
-{
-    bool success = mqttManager->sendCredentials(username, password);
-    if (success)
-    {
-        credentialsSent = true;
-    }
-    return success;
-}
-
-String WebInterface::getMainPage()
-{
-    return R"rawliteral(
+// Served straight from flash; the async server streams it in TCP-window sized pieces
+static const char MAIN_PAGE[] PROGMEM = R"rawliteral(
 <!DOCTYPE html>
 <html lang="en">
 <head>
@@ -781,7 +674,7 @@ String WebInterface::getMainPage()
                     <div class="success-icon">✅</div>
                     <div class="success-title">Setup Complete!</div>
                     <div class="success-message">
-                        Your GreenTech device is being configured and will restart shortly. 
+                        Your GreenTech device is applying the new settings and will join your network shortly. 
                         You'll be redirected to the dashboard in a few moments.
                     </div>
                     
@@ -935,8 +828,13 @@ String WebInterface::getMainPage()
             scanBtn.innerHTML = '<span class="loading"></span> Scanning...';
             
             try {
-                const response = await fetch('/scan');
-                const data = await response.json();
+                // The scan runs in the background on the device; poll until it is done
+                let data = { scanning: true };
+                for (let attempt = 0; data.scanning && attempt < 20; attempt++) {
+                    if (attempt > 0) await new Promise(resolve => setTimeout(resolve, 500));
+                    const response = await fetch('/scan');
+                    data = await response.json();
+                }
                 
                 networksDiv.innerHTML = '';
                 
@@ -1003,4 +901,190 @@ String WebInterface::getMainPage()
 </body>
 </html>
 )rawliteral";
-}
\ No newline at end of file
+
+void WebInterface::initialize(PreferencesManager &prefs, MQTTManager &mqtt, Core &coreRef)
+{
+    // Called again whenever the device falls back to the setup AP; routes are registered once
+    if (started)
+        return;
+
+    preferences = &prefs;
+    mqttManager = &mqtt;
+    core = &coreRef;
+
+    server.on("/", HTTP_GET, std::bind(&WebInterface::handleRoot, this, std::placeholders::_1));
+    server.on("/scan", HTTP_GET, std::bind(&WebInterface::handleScan, this, std::placeholders::_1));
+    server.on("/configure", HTTP_POST, std::bind(&WebInterface::handleConfigure, this, std::placeholders::_1),
+              nullptr,
+              std::bind(&WebInterface::handleConfigureBody, this, std::placeholders::_1, std::placeholders::_2,
+                        std::placeholders::_3, std::placeholders::_4, std::placeholders::_5));
+    server.on("/test", HTTP_GET, std::bind(&WebInterface::handleTest, this, std::placeholders::_1));
+    server.on("/traces", HTTP_GET, std::bind(&WebInterface::handleTraces, this, std::placeholders::_1));
+    server.on("/relays", HTTP_GET, std::bind(&WebInterface::handleRelays, this, std::placeholders::_1));
+
+    server.begin();
+    started = true;
+
+    Serial.println("✅ Web server started");
+    Serial.println("📍 Available endpoints:");
+    Serial.println("   - http://192.168.4.1/ (main page)");
+    Serial.println("   - http://192.168.4.1/scan (WiFi scan, access point only)");
+    Serial.println("   - http://192.168.4.1/configure (setup, access point only)");
+    Serial.println("   - http://192.168.4.1/test (debug)");
+    Serial.println("   - http://192.168.4.1/traces (command traces)");
+    Serial.println("   - http://192.168.4.1/relays (relay snapshot)");
+}
+
+// The server also runs in station mode for diagnostics. Routes that change settings or
+// disturb the radio answer only on the setup access point, never on the LAN.
+bool WebInterface::isSetupRequest(AsyncWebServerRequest *request)
+{
+    return wifiManager.isSoftAPActive() && request->client()->localIP() == WiFi.softAPIP();
+}
+
+void WebInterface::handleRoot(AsyncWebServerRequest *request)
+{
+    Serial.println("📄 Serving main page to client");
+    request->send_P(200, "text/html", MAIN_PAGE);
+}
+
+void WebInterface::handleScan(AsyncWebServerRequest *request)
+{
+    if (!isSetupRequest(request))
+    {
+        request->send(403, "application/json", "{\"success\":false,\"message\":\"Setup access point only\"}");
+        return;
+    }
+
+    // A blocking scan would stall every other client, so scan in the background and let
+    // the page poll until results are ready
+    int numNetworks = WiFi.scanComplete();
+    if (numNetworks == WIFI_SCAN_FAILED)
+    {
+        Serial.println("📡 Starting background WiFi scan");
+        WiFi.scanNetworks(true);
+        numNetworks = WIFI_SCAN_RUNNING;
+    }
+    if (numNetworks == WIFI_SCAN_RUNNING)
+    {
+        request->send(202, "application/json", "{\"scanning\":true}");
+        return;
+    }
+
+    JsonDocument doc;
+    JsonArray networks = doc["networks"].to<JsonArray>();
+
+    for (int i = 0; i < numNetworks; i++)
+    {
+        networks.add(WiFi.SSID(i));
+    }
+    WiFi.scanDelete();
+
+    String response;
+    serializeJson(doc, response);
+    request->send(200, "application/json", response);
+
+    Serial.println("✅ Sent " + String(numNetworks) + " networks to client");
+}
+
+void WebInterface::handleTest(AsyncWebServerRequest *request)
+{
+    Serial.println("✅ Test endpoint accessed");
+    request->send(200, "text/plain", "Web server is working!");
+}
+
+void WebInterface::handleTraces(AsyncWebServerRequest *request)
+{
+    AsyncResponseStream *response = request->beginResponseStream("application/json");
+    JsonDocument doc;
+    doc["deviceId"] = core->getDeviceId();
+    commandTracer.fillTraces(doc["traces"].to<JsonArray>());
+    serializeJson(doc, *response);
+    request->send(response);
+}
+
+// Runs on the AsyncTCP task while loop() and the pulse timers keep switching relays
+void WebInterface::handleRelays(AsyncWebServerRequest *request)
+{
+    RelaySnapshot snapshot;
+    relayController.getSnapshot(snapshot);
+
+    AsyncResponseStream *response = request->beginResponseStream("application/json");
+    JsonDocument doc;
+    doc["deviceId"] = core->getDeviceId();
+    doc["version"] = snapshot.version;
+    JsonArray relays = doc["relays"].to<JsonArray>();
+    for (int i = 0; i < relayController.RELAY_COUNT; i++)
+    {
+        JsonObject relay = relays.add<JsonObject>();
+        relay["index"] = i;
+        relay["state"] = snapshot.states[i];
+        relay["timer"] = snapshot.timers[i];
+        relay["pulsing"] = snapshot.isPulsing(i);
+    }
+    serializeJson(doc, *response);
+    request->send(response);
+}
+
+// The body arrives in TCP-sized pieces; collect it into a bounded per-request buffer
+void WebInterface::handleConfigureBody(AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total)
+{
+    if (total > MAX_BODY_SIZE || !isSetupRequest(request))
+        return;
+    if (index == 0)
+        request->_tempObject = calloc(total + 1, 1);
+    if (request->_tempObject)
+        memcpy((uint8_t *)request->_tempObject + index, data, len);
+}
+
+void WebInterface::handleConfigure(AsyncWebServerRequest *request)
+{
+    if (!isSetupRequest(request))
+    {
+        request->send(403, "application/json", "{\"success\":false,\"message\":\"Setup access point only\"}");
+        return;
+    }
+    if (!request->_tempObject)
+    {
+        request->send(413, "application/json", "{\"success\":false,\"message\":\"Request body missing or too large\"}");
+        return;
+    }
+
+    const char *body = (const char *)request->_tempObject;
+    JsonDocument doc;
+    if (deserializeJson(doc, body) || !doc.is<JsonObject>())
+    {
+        request->send(400, "application/json", "{\"success\":false,\"message\":\"Invalid JSON\"}");
+        return;
+    }
+
+    Serial.println("=== CONFIGURATION RECEIVED ===");
+    Serial.println("SSID: " + String(doc["ssid"] | ""));
+    Serial.println("Username: " + String(doc["username"] | ""));
+    Serial.println("========================");
+
+    // Applied from loop(); only the subsystems whose settings changed are restarted
+    if (!configManager.submit(body, strlen(body), "http"))
+    {
+        request->send(413, "application/json", "{\"success\":false,\"message\":\"Configuration too large\"}");
+        return;
+    }
+
+    JsonDocument responseDoc;
+    responseDoc["success"] = true;
+    responseDoc["message"] = "Configuration received! The device is applying it and will connect to your network.";
+
+    String response;
+    serializeJson(responseDoc, response);
+    request->send(200, "application/json", response);
+}
+
+bool WebInterface::sendCredentialsToDatabase(const String &username, const String &password)
+{
+    bool success = mqttManager->sendCredentials(username, password);
+    if (success)
+    {
+        credentialsSent = true;
+    }
+    return success;
+}
@@ -1,32 +1,38 @@
 #ifndef WEB_INTERFACE_H
 #define WEB_INTERFACE_H
 
-#include <WebServer.h>
+#include <ESPAsyncWebServer.h>
 #include <ArduinoJson.h>
 #include "PreferencesManager/PreferencesManager.h"
 #include "MQTTManager/MQTTManager.h"
 #include "Core/Core.h"
+#include "ConfigManager/ConfigManager.h"
 
 class WebInterface
 {
 public:
     void initialize(PreferencesManager &prefs, MQTTManager &mqtt, Core &coreRef);
-    void handleClient();
-    void handleRoot();
-    void handleScan();
-    void handleConfigure();
-    void handleTest(); // Add this line
-    String getMainPage();
+    void handleRoot(AsyncWebServerRequest *request);
+    void handleScan(AsyncWebServerRequest *request);
+    void handleConfigure(AsyncWebServerRequest *request);
+    void handleConfigureBody(AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total);
+    void handleTest(AsyncWebServerRequest *request); // Add this line
+    void handleTraces(AsyncWebServerRequest *request);
+    void handleRelays(AsyncWebServerRequest *request);
     bool areCredentialsSent() const { return credentialsSent; }
     void setCredentialsSent(bool sent) { credentialsSent = sent; }
 
 private:
-    WebServer server{80};
+    static const size_t MAX_BODY_SIZE = ConfigManager::MAX_CONFIG_SIZE;
+
+    AsyncWebServer server{80};
+    bool started = false;
     PreferencesManager *preferences;
     MQTTManager *mqttManager;
     Core *core;
     bool credentialsSent = false;
 
+    static bool isSetupRequest(AsyncWebServerRequest *request);
     bool sendCredentialsToDatabase(const String &username, const String &password);
 };
 
@@ -1,4 +1,5 @@
 #include "WiFiManager.h"
+#include "Clock/Clock.h"
 
 WiFiManager wifiManager;
 
@@ -9,6 +10,9 @@ void WiFiManager::initialize(PreferencesManager &prefs)
 
 void WiFiManager::startSoftAP()
 {
+    if (softAPActive)
+        return;
+    softAPActive = true;
     WiFi.softAP(SOFT_AP_SSID, SOFT_AP_PASSWORD);
     Serial.println("Soft AP Started");
     Serial.print("SSID: ");
@@ -19,6 +23,15 @@ void WiFiManager::startSoftAP()
     Serial.println(WiFi.softAPIP());
 }
 
+void WiFiManager::stopSoftAP()
+{
+    if (!softAPActive)
+        return;
+    softAPActive = false;
+    WiFi.softAPdisconnect(true);
+    Serial.println("📴 Soft AP stopped");
+}
+
 void WiFiManager::connectToWiFi()
 {
     String ssid = preferences->getWiFiSSID();
@@ -27,29 +40,162 @@ void WiFiManager::connectToWiFi()
     if (ssid == "")
     {
         Serial.println("❌ No WiFi credentials found");
+        state = IDLE;
         return;
     }
 
-    Serial.print("📡 Connecting to WiFi: ");
-    Serial.println(ssid);
-    WiFi.begin(ssid.c_str(), password.c_str());
+    // Keep a fallback portal up while the station retries
+    WiFi.mode(softAPActive ? WIFI_AP_STA : WIFI_STA);
+    WiFi.persistent(false);
 
-    int attempts = 0;
-    while (WiFi.status() != WL_CONNECTED && attempts < 20)
+    WiFiCache cache;
+    if (preferences->getWiFiCache(cache))
     {
-        delay(1000);
-        Serial.print(".");
-        attempts++;
+        beginFastConnect(cache, ssid, password);
+        return;
     }
+    beginFullConnect();
+}
+
+void WiFiManager::reconnect(const String &previousSsid, const String &previousPassword)
+{
+    rollbackPending = previousSsid != "";
+    rollbackSsid = previousSsid;
+    rollbackPassword = previousPassword;
+    // The cached BSSID belongs to the old network
+    preferences->clearWiFiCache();
+    WiFi.disconnect();
+    connectToWiFi();
+}
+
+// The new network never associated: go back to the one that worked
+void WiFiManager::rollback()
+{
+    Serial.println("↩️ WiFi " + preferences->getWiFiSSID() + " did not associate, restoring " + rollbackSsid);
+    rollbackPending = false;
+    preferences->setWiFiCredentials(rollbackSsid, rollbackPassword);
+    rollbackSsid = "";
+    rollbackPassword = "";
+    WiFi.disconnect();
+    connectToWiFi();
+}
 
-    if (WiFi.status() == WL_CONNECTED)
+void WiFiManager::beginFastConnect(const WiFiCache &cache, const String &ssid, const String &password)
+{
+    // Skip the channel scan, which dominates join time. The address still comes from DHCP:
+    // reusing a cached lease as a static IP never renews it and collides once it expires.
+    WiFi.begin(ssid.c_str(), password.c_str(), cache.channel, cache.bssid, true);
+    state = FAST_CONNECTING;
+    stateSince = systemClock().now();
+}
+
+void WiFiManager::beginFullConnect()
+{
+    String ssid = preferences->getWiFiSSID();
+    Serial.print("📡 Connecting to WiFi: ");
+    Serial.println(ssid);
+    WiFi.begin(ssid.c_str(), preferences->getWiFiPassword().c_str());
+    state = CONNECTING;
+    stateSince = systemClock().now();
+}
+
+void WiFiManager::onConnected()
+{
+    bool fast = state == FAST_CONNECTING;
+    state = CONNECTED;
+    failedAttempts = 0;
+    rollbackPending = false;
+    rollbackSsid = "";
+    rollbackPassword = "";
+    Serial.print(fast ? "⚡ WiFi fast-connected, IP: " : "✅ WiFi Connected! IP: ");
+    Serial.println(WiFi.localIP());
+    // Refreshed after every join (written only when it changed), so a roam is picked up
+    saveConnectionCache();
+}
+
+// Join timeouts and retry backoff are scheduling, so they follow systemClock() like every
+// other interval
+bool WiFiManager::loop(unsigned long now)
+{
+    switch (state)
     {
-        Serial.println("\n✅ WiFi Connected!");
-        Serial.print("📍 IP Address: ");
-        Serial.println(WiFi.localIP());
+    case FAST_CONNECTING:
+        if (isConnected())
+        {
+            onConnected();
+            return true;
+        }
+        if (now - stateSince >= FAST_CONNECT_TIMEOUT_MS)
+        {
+            // AP moved channel or BSSID: forget the cache and fall back to a full scan
+            Serial.println("⚠️ Fast WiFi connect failed, doing a full scan");
+            preferences->clearWiFiCache();
+            WiFi.disconnect();
+            beginFullConnect();
+        }
+        return false;
+
+    case CONNECTING:
+        if (isConnected())
+        {
+            onConnected();
+            return true;
+        }
+        if (now - stateSince >= FULL_CONNECT_TIMEOUT_MS)
+        {
+            if (rollbackPending)
+            {
+                rollback();
+                return false;
+            }
+            Serial.println("❌ WiFi Connection Failed, retrying in " + String(RETRY_DELAY_MS / 1000) + " s");
+            failedAttempts++;
+            WiFi.disconnect();
+            state = WAITING;
+            stateSince = now;
+        }
+        return false;
+
+    case WAITING:
+        if (now - stateSince >= RETRY_DELAY_MS)
+            connectToWiFi();
+        return false;
+
+    case CONNECTED:
+        if (!isConnected())
+        {
+            Serial.println("📡 WiFi disconnected, attempting to reconnect...");
+            connectToWiFi();
+        }
+        return false;
+
+    default:
+        return false;
     }
-    else
+}
+
+unsigned long WiFiManager::getMillisUntilNextStep(unsigned long now) const
+{
+    switch (state)
     {
-        Serial.println("\n❌ WiFi Connection Failed");
+    case FAST_CONNECTING:
+    case CONNECTING:
+        return POLL_INTERVAL_MS;
+    case WAITING:
+        return now - stateSince >= RETRY_DELAY_MS ? 0 : RETRY_DELAY_MS - (now - stateSince);
+    case CONNECTED:
+        // A dropped link shows up as a closed MQTT socket, which wakes the loop anyway
+        return isConnected() ? ULONG_MAX : 0;
+    default:
+        return ULONG_MAX;
     }
-}
\ No newline at end of file
+}
+
+void WiFiManager::saveConnectionCache()
+{
+    WiFiCache cache;
+    memset(&cache, 0, sizeof(cache));
+    memcpy(cache.bssid, WiFi.BSSID(), sizeof(cache.bssid));
+    cache.channel = WiFi.channel();
+    preferences->setWiFiCache(cache);
+}
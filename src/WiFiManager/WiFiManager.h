@@ -4,21 +4,64 @@
 #include <WiFi.h>
 #include "PreferencesManager/PreferencesManager.h"
 
+// Station connection as a non-blocking state machine: connectToWiFi() only starts an
+// attempt and loop() carries it forward, so relay timers, programs and rules keep running
+// while the network is down. An attempt tries the cached channel/BSSID first, then a full
+// scan; a failed attempt is retried after RETRY_DELAY_MS.
 class WiFiManager
 {
 public:
+    enum State
+    {
+        IDLE,
+        FAST_CONNECTING,
+        CONNECTING,
+        CONNECTED,
+        WAITING
+    };
+
     void initialize(PreferencesManager &prefs);
     void startSoftAP();
+    void stopSoftAP();
+    bool isSoftAPActive() const { return softAPActive; }
+    // Starts joining the network stored in preferences
     void connectToWiFi();
+    // Drops the current association and joins the network now stored in preferences. If it
+    // has not associated within FULL_CONNECT_TIMEOUT_MS, the previous credentials are
+    // restored and joined again.
+    void reconnect(const String &previousSsid, const String &previousPassword);
+    // Call every loop() pass; returns true on the pass the link comes up
+    bool loop(unsigned long now);
+    unsigned long getMillisUntilNextStep(unsigned long now) const;
+    // A full attempt has failed since the link was last up
+    bool hasFailed() const { return failedAttempts > 0; }
+
     bool isConnected() const { return WiFi.status() == WL_CONNECTED; }
     String getIPAddress() const { return WiFi.localIP().toString(); }
 
 private:
+    void beginFastConnect(const WiFiCache &cache, const String &ssid, const String &password);
+    void beginFullConnect();
+    void onConnected();
+    void rollback();
+    void saveConnectionCache();
+
     PreferencesManager *preferences;
+    State state = IDLE;
+    unsigned long stateSince = 0;
+    uint32_t failedAttempts = 0;
+    bool softAPActive = false;
+    bool rollbackPending = false;
+    String rollbackSsid;
+    String rollbackPassword;
+    const unsigned long FAST_CONNECT_TIMEOUT_MS = 3000; // Association plus DHCP
+    const unsigned long FULL_CONNECT_TIMEOUT_MS = 20000;
+    const unsigned long RETRY_DELAY_MS = 10000;
+    const unsigned long POLL_INTERVAL_MS = 100;
     const char *SOFT_AP_SSID = "green-tech";
     const char *SOFT_AP_PASSWORD = "12345678";
 };
 
 extern WiFiManager wifiManager; // Declaration only
 
-#endif
\ No newline at end of file
+#endif
@@ -6,18 +6,331 @@
 #include <Preferences.h>
 
 // Include all module headers
+#include "Clock/Clock.h"
 #include "Core/Core.h"
 #include "WiFiManager/WiFiManager.h"
 #include "MQTTManager/MQTTManager.h"
 #include "RelayController/RelayController.h"
 #include "WebInterface/WebInterface.h"
 #include "PreferencesManager/PreferencesManager.h"
+#include "OTAManager/OTAManager.h"
+#include "PowerManager/PowerManager.h"
+#include "SensorManager/SensorManager.h"
+#include "RuleEngine/RuleEngine.h"
+#include "TimeSeriesStore/TimeSeriesStore.h"
+#include "CommandLimiter/CommandLimiter.h"
+#include "BrokerManager/BrokerManager.h"
+#include "CommandTracer/CommandTracer.h"
+#include "ConfigManager/ConfigManager.h"
+#include "StatusReporter/StatusReporter.h"
+#include "GroupManager/GroupManager.h"
+#include "LoopWatchdog/LoopWatchdog.h"
+#include "InputManager/InputManager.h"
+#include "ProgramRunner/ProgramRunner.h"
+#include "ShadowManager/ShadowManager.h"
+#ifdef SENSOR_SIMULATION
+#include "SensorManager/SimulatedSampleSource.h"
+#else
+#include "SensorManager/AdcSampleSource.h"
+#endif
 
 // Only declare WiFiClient here - all other globals are defined in their respective .cpp files
 WiFiClient wifiClient;
 
+// Build with -DSENSOR_SIMULATION to run the sensor pipeline without probes attached
+#ifdef SENSOR_SIMULATION
+SimulatedSampleSource sampleSource;
+#else
+AdcSampleSource sampleSource;
+#endif
+
+const unsigned long CREDENTIAL_CHECK_INTERVAL_MS = 60000;
+unsigned long lastCredentialCheck = 0;
+const unsigned long MQTT_RETRY_INTERVAL_MS = 5000;
+unsigned long lastMqttAttempt = 0UL - MQTT_RETRY_INTERVAL_MS; // First attempt right away
+
+unsigned long millisUntil(unsigned long last, unsigned long interval, unsigned long now)
+{
+    unsigned long elapsed = now - last;
+    return elapsed >= interval ? 0 : interval - elapsed;
+}
+
+void fillMetrics(JsonObject metrics)
+{
+    powerManager.fillMetrics(metrics["power"].to<JsonObject>());
+    relayController.fillMetrics(metrics["relays"].to<JsonObject>());
+    commandLimiter.fillMetrics(metrics["commands"].to<JsonObject>());
+    brokerManager.fillMetrics(metrics["broker"].to<JsonObject>());
+    loopWatchdog.fillMetrics(metrics["loop"].to<JsonObject>());
+    inputManager.fillMetrics(metrics["inputs"].to<JsonObject>());
+    statusReporter.fillMetrics(metrics["status"].to<JsonObject>());
+    shadowManager.fillMetrics(metrics["shadow"].to<JsonObject>());
+}
+
+// Windowed figures cover the span between heartbeats; only the heartbeat starts a new
+// window, so an ad-hoc metrics query leaves them alone
+void sendMetrics()
+{
+    JsonDocument doc;
+    fillMetrics(doc.to<JsonObject>());
+    mqttManager.sendMetrics(doc);
+    powerManager.resetMetrics();
+    relayController.resetMetrics();
+    loopWatchdog.resetMetrics();
+    inputManager.resetMetrics();
+}
+
+// A rule owns its relay against the desired-state document until the next version
+void onRuleActuation(int relay)
+{
+    shadowManager.holdRelays(1UL << relay);
+}
+
+void onSensorReading(const SensorReading &reading)
+{
+    // Rules run on every sample, locally; loop() samples whether or not WiFi and the broker
+    // are up, so control and the history record continue through outages
+    ruleEngine.evaluate(reading);
+    timeSeriesStore.recordReading(reading);
+}
+
+// Toggles are resolved on arrival so a coalesced toggle keeps the meaning it had when sent
+void resolveToggle(RelayCommand &command)
+{
+    if (command.action != RelayCommand::TOGGLE)
+        return;
+
+    bool current = relayController.getRelayState(command.relay);
+    RelayCommand pendingCommand;
+    if (commandLimiter.getPendingCommand(command.relay, pendingCommand))
+        current = pendingCommand.action != RelayCommand::OFF;
+    command.action = current ? RelayCommand::OFF : RelayCommand::ON;
+}
+
+void applyRelayCommand(const RelayCommand &command)
+{
+    relayController.applyCommand(command);
+    // Untraced changes are reported by StatusReporter as a debounced delta
+    if (!command.isTraced())
+        return;
+
+    TraceRecord trace = commandTracer.record(command, relayController.getLastOutputTime(command.relay));
+    RelaySnapshot snapshot;
+    relayController.getSnapshot(snapshot);
+    mqttManager.sendRelayStatus(command.relay, snapshot.states[command.relay], snapshot.timers[command.relay],
+                                snapshot.version, &trace);
+}
+
+// Inputs switch relays on their own task; report here, and drop any queued remote command
+// for the same relay so it cannot undo the override a moment later
+void reportManualOverrides()
+{
+    uint32_t overridden = inputManager.takeOverriddenMask();
+    if (!overridden)
+        return;
+    shadowManager.holdRelays(overridden);
+
+    RelaySnapshot snapshot;
+    relayController.getSnapshot(snapshot);
+    for (int i = 0; i < relayController.RELAY_COUNT; i++)
+    {
+        if (!(overridden & (1UL << i)))
+            continue;
+        commandLimiter.cancelPending(i);
+        mqttManager.sendRelayStatus(i, snapshot.states[i], snapshot.timers[i], snapshot.version);
+        Serial.println("🔘 Manual override on relay " + String(i));
+    }
+}
+
+// Emergency lane: stops bypass the rate limiter and drop any routine command still
+// waiting for the same relay, so nothing queued can switch it back on afterwards.
+// Only commands that switch off qualify; an emergency flag cannot fast-track an "on".
+bool isEmergency(const char *topic, JsonDocument &doc, const String &action)
+{
+    if (action == "all-off" || action == "stop")
+        return true;
+    return action == "off" && (mqttManager.isEmergencyTopic(topic) || doc["priority"] == "emergency");
+}
+
+// Cheap pre-parse check so a possible emergency on the routine topic is not dropped by the
+// rate limiter. A false positive only costs the parse: the limiter is charged after it.
+bool mayBeEmergency(const byte *payload, unsigned int length)
+{
+    static const char *const MARKERS[] = {"all-off", "\"stop\""};
+    for (const char *marker : MARKERS)
+    {
+        if (memmem(payload, length, marker, strlen(marker)))
+            return true;
+    }
+    return memmem(payload, length, "emergency", 9) && memmem(payload, length, "\"off\"", 5);
+}
+
+void applyEmergency(JsonDocument &doc, const String &action, int64_t receivedAt)
+{
+    if (action == "all-off")
+    {
+        for (int i = 0; i < relayController.RELAY_COUNT; i++)
+        {
+            commandLimiter.cancelPending(i);
+            relayController.stopRelay(i);
+        }
+        programRunner.stop(systemClock().now());
+        ruleEngine.suspend();
+        // A replayed desired-state document must not switch anything back on
+        shadowManager.holdRelays((1UL << relayController.RELAY_COUNT) - 1);
+        Serial.println("🚨 Emergency: all relays off");
+        statusReporter.flush();
+        return;
+    }
+
+    // stop and off: isEmergency() admits nothing else
+    RelayCommand command;
+    command.decode(doc);
+    if (command.relay < 0 || command.relay >= relayController.RELAY_COUNT)
+        return;
+
+    command.receivedAt = receivedAt;
+    command.decodedAt = esp_timer_get_time();
+    commandLimiter.cancelPending(command.relay);
+    relayController.stopRelay(command.relay);
+    shadowManager.holdRelays(1UL << command.relay);
+    command.action = RelayCommand::NONE; // Already applied; only report
+    applyRelayCommand(command);
+    statusReporter.flush();
+    Serial.println("🚨 Emergency command on relay " + String(command.relay));
+}
+
+// Start a program, or steer the one that is running; every control answers with a status
+void handleProgramCommand(JsonDocument &doc)
+{
+    String control = doc["control"] | "start";
+    unsigned long now = systemClock().now();
+    String error;
+    bool accepted = true;
+    if (control == "start")
+        accepted = programRunner.start(doc["program"], now, error);
+    else if (control == "pause")
+        accepted = programRunner.pause(now);
+    else if (control == "resume")
+        accepted = programRunner.resume(now);
+    else if (control == "skip")
+        accepted = programRunner.skip(now);
+    else if (control == "stop")
+        programRunner.stop(now);
+    else if (control != "status")
+        accepted = false;
+
+    JsonDocument status;
+    programRunner.fillStatus(status, now);
+    status["control"] = control;
+    if (!accepted)
+        status["error"] = error.length() ? error : "not applicable";
+    mqttManager.sendProgramStatus(status);
+    // Already reported above
+    programRunner.takeStatusChange();
+}
+
+// Request/response: the answer goes to the caller's replyTo topic and echoes its
+// correlationId, so a backend gets current state in one round trip
+void handleQuery(JsonDocument &request)
+{
+    String query = request["query"] | "snapshot";
+    JsonDocument response;
+    response["correlationId"] = request["correlationId"];
+    response["query"] = query;
+    response["status"] = "ok";
+
+    RelaySnapshot snapshot;
+    relayController.getSnapshot(snapshot);
+    if (query == "snapshot")
+    {
+        mqttManager.fillDeviceStatus(response, snapshot);
+    }
+    else if (query == "relays")
+    {
+        // All relays unless a list of indexes is given
+        response["version"] = snapshot.version;
+        JsonArray relays = response["relays"].to<JsonArray>();
+        JsonArrayConst wanted = request["relays"];
+        int count = wanted.isNull() ? relayController.RELAY_COUNT : wanted.size();
+        for (int i = 0; i < count; i++)
+        {
+            int index = wanted.isNull() ? i : (wanted[i] | -1);
+            if (index < 0 || index >= relayController.RELAY_COUNT)
+                continue;
+            JsonObject relay = relays.add<JsonObject>();
+            relay["index"] = index;
+            relay["state"] = snapshot.states[index];
+            relay["timer"] = snapshot.timers[index];
+        }
+    }
+    else if (query == "config")
+    {
+        configManager.fillConfig(response["config"].to<JsonObject>());
+    }
+    else if (query == "metrics")
+    {
+        fillMetrics(response["metrics"].to<JsonObject>());
+    }
+    else
+    {
+        response["status"] = "error";
+        response["error"] = "unknown query";
+    }
+
+    mqttManager.sendResponse(request["replyTo"] | "", response);
+}
+
+void submitRelayCommand(JsonDocument &doc, int64_t receivedAt, unsigned long stagger)
+{
+    RelayCommand command;
+    if (!command.decode(doc))
+        return;
+    command.receivedAt = receivedAt;
+    command.decodedAt = esp_timer_get_time();
+
+    resolveToggle(command);
+    if (commandLimiter.submit(command, systemClock().now(), stagger) == CommandLimiter::APPLY_NOW)
+        applyRelayCommand(command);
+}
+
 void mqttCallback(char *topic, byte *payload, unsigned int length)
 {
+    int64_t receivedAt = esp_timer_get_time();
+
+    if (mqttManager.handleInternalMessage(topic, payload, length))
+        return;
+
+    if (mqttManager.isConfigTopic(topic))
+    {
+        if (!configManager.submit((const char *)payload, length, "mqtt"))
+            mqttManager.sendConfigStatus(0, "mqtt", "config too large");
+        return;
+    }
+
+    if (mqttManager.isDesiredTopic(topic))
+    {
+        // Collect overrides made since the last pass so the document cannot undo them
+        reportManualOverrides();
+        String error;
+        if (!shadowManager.setDesired(payload, length, error))
+            Serial.println("⚠️ Desired state rejected: " + error);
+        return;
+    }
+
+    // Skip the parse entirely for messages addressed to other devices. Group messages carry
+    // no deviceId; the subscription itself is the address.
+    bool groupMessage = mqttManager.isGroupTopic(topic);
+    String deviceId = core.getDeviceId();
+    if (!groupMessage && (length < deviceId.length() || !memmem(payload, length, deviceId.c_str(), deviceId.length())))
+        return;
+
+    // Emergencies on the routine topic must not wait behind the limiter either
+    bool emergencyTopic = mqttManager.isEmergencyTopic(topic);
+    bool suspected = !emergencyTopic && mayBeEmergency(payload, length);
+    if (!emergencyTopic && !suspected && !commandLimiter.admitMessage(systemClock().now()))
+        return;
+
     String message;
     for (int i = 0; i < length; i++)
     {
@@ -30,41 +343,125 @@ void mqttCallback(char *topic, byte *payload, unsigned int length)
     deserializeJson(doc, message);
 
     String targetDevice = doc["deviceId"];
-    if (targetDevice != core.getDeviceId())
+    if (!groupMessage && targetDevice != deviceId)
         return;
 
-    int relayIndex = doc["relay"];
     String action = doc["action"];
 
-    if (action == "on")
+    if (isEmergency(topic, doc, action))
     {
-        relayController.setRelayState(relayIndex, true);
+        applyEmergency(doc, action, receivedAt);
+        return;
     }
-    else if (action == "off")
+    if (emergencyTopic)
     {
-        relayController.setRelayState(relayIndex, false);
+        Serial.println("⚠️ Emergency topic takes only off, stop and all-off; ignored " + action);
+        return;
     }
-    else if (action == "toggle")
+    if (suspected && !commandLimiter.admitMessage(systemClock().now()))
+        return;
+
+    // A group topic addresses relays only: anyone who can publish to it must not be able
+    // to reflash, reconfigure or query a whole zone
+    if (groupMessage)
     {
-        relayController.setRelayState(relayIndex, !relayController.getRelayState(relayIndex));
+        submitRelayCommand(doc, receivedAt, groupManager.getStaggerDelay(doc));
+        return;
+    }
+
+    if (action == "ota")
+    {
+        otaManager.begin(doc["url"] | "", doc["sha256"] | "", doc["size"] | 0, doc["reboot"] | true);
+        return;
+    }
+
+    // Settings changes share the config pipeline; the extra deviceId/action keys are ignored
+    if (action == "config" || action == "sensors" || action == "rules" || action == "brokers" || action == "groups")
+    {
+        if (!configManager.submit(message.c_str(), message.length(), "mqtt"))
+            mqttManager.sendConfigStatus(0, "mqtt", "config too large");
+        return;
+    }
+
+    if (action == "history")
+    {
+        String source = doc["source"] | "ram";
+        timeSeriesStore.requestUpload(source == "flash");
+        return;
+    }
+
+    if (action == "traces")
+    {
+        mqttManager.sendTraces(commandTracer);
+        return;
+    }
+
+    if (action == "resync")
+    {
+        statusReporter.sendSnapshot(systemClock().now());
+        return;
+    }
+
+    if (action == "query")
+    {
+        handleQuery(doc);
+        return;
     }
-    else if (action == "timer")
+
+    if (action == "program")
     {
-        unsigned long duration = doc["duration"];
-        relayController.setRelayTimer(relayIndex, duration);
+        handleProgramCommand(doc);
+        return;
     }
 
-    // Send status update
-    mqttManager.sendRelayStatus(relayIndex,
-                                relayController.getRelayState(relayIndex),
-                                relayController.getRelayTimer(relayIndex));
+    submitRelayCommand(doc, receivedAt, 0);
+}
+
+// Brings up the subsystems that need a network; runs at boot, or when setup mode is left
+void startStationMode()
+{
+    // Only starts the join; loop() completes it while local control is already running
+    Serial.println("🔗 Connecting to WiFi...");
+    wifiManager.connectToWiFi();
+    powerManager.initialize(preferencesManager.getLightSleepEnabled());
+    sensorManager.initialize(sampleSource, preferencesManager.getSampleInterval(),
+                             preferencesManager.getTelemetryInterval());
+    ruleEngine.initialize(relayController);
+    ruleEngine.loadRules(preferencesManager.getRules());
+    ruleEngine.setActuationCallback(onRuleActuation);
+    sensorManager.setSampleCallback(onSensorReading);
+    // The async server costs nothing while idle, so keep diagnostics reachable on the LAN
+    webInterface.initialize(preferencesManager, mqttManager, core);
+}
+
+void onConfigApplied(uint32_t changes, const char *source, const char *error)
+{
+    mqttManager.sendConfigStatus(changes, source, error);
+
+    // First configuration from the setup portal: join the network without rebooting
+    if (!core.isDeviceConfigured() && preferencesManager.isConfigured())
+    {
+        Serial.println("✅ Leaving setup mode");
+        core.setDeviceConfigured(true);
+        startStationMode();
+    }
 }
 
 void setup()
 {
     core.initialize();
+    loopWatchdog.initialize();
     preferencesManager.initialize();
     relayController.initialize();
+    // Manual overrides work from here on, whatever happens to WiFi and MQTT
+    inputManager.initialize(relayController, preferencesManager);
+    programRunner.initialize(relayController);
+    shadowManager.initialize(relayController, preferencesManager, programRunner);
+    core.markBootPhase("relays");
+    commandLimiter.initialize();
+    timeSeriesStore.initialize();
+    configManager.initialize(preferencesManager);
+    configManager.setAppliedCallback(onConfigApplied);
 
     core.setDeviceConfigured(preferencesManager.isConfigured());
 
@@ -82,13 +479,15 @@ void setup()
     }
     else
     {
-        Serial.println("🔗 Connecting to WiFi...");
-        wifiManager.connectToWiFi();
+        startStationMode();
     }
 
     // Initialize MQTT (but don't connect immediately)
-    mqttManager.initialize(wifiClient, core);
+    brokerManager.initialize(preferencesManager);
+    groupManager.initialize(preferencesManager, core.getDeviceId());
+    mqttManager.initialize(wifiClient, core, brokerManager, groupManager);
     mqttManager.setCallback(mqttCallback);
+    statusReporter.initialize(relayController, mqttManager, preferencesManager.getHeartbeatInterval());
 
     Serial.println("==========================================");
 }
@@ -113,79 +512,220 @@ void checkAndSendCredentials()
     }
 }
 
-void loop()
+// Keeps WiFi and MQTT up without blocking local control. Returns true while MQTT is connected.
+bool maintainConnection()
 {
-    if (!core.isDeviceConfigured())
+    loopWatchdog.enter(LoopWatchdog::WIFI_CONNECT);
+    if (wifiManager.loop(systemClock().now()))
     {
-        // In setup mode, handle web server clients
-        webInterface.handleClient();
-        delay(10);
+        static bool wifiPhaseMarked = false;
+        if (!wifiPhaseMarked)
+        {
+            core.markBootPhase("wifi");
+            wifiPhaseMarked = true;
+        }
+        // Back on the network: the fallback portal is no longer needed
+        wifiManager.stopSoftAP();
     }
-    else
+
+    if (!wifiManager.isConnected())
+    {
+        // Station join keeps retrying in the background; offer the portal once an attempt failed
+        if (wifiManager.hasFailed() && !wifiManager.isSoftAPActive())
+        {
+            Serial.println("🚀 WiFi unreachable, starting fallback Setup Mode...");
+            wifiManager.startSoftAP();
+            Serial.println("📍 Setup Portal Ready at: http://192.168.4.1");
+        }
+        return false;
+    }
+
+    // Ensure MQTT is connected; attempts are paced so a dead broker cannot starve the loop
+    if (!mqttManager.isConnected() && systemClock().now() - lastMqttAttempt >= MQTT_RETRY_INTERVAL_MS)
     {
-        // In normal operation mode
-        if (wifiManager.isConnected())
+        loopWatchdog.enter(LoopWatchdog::MQTT_CONNECT);
+        lastMqttAttempt = systemClock().now();
+        Serial.println("🔗 Attempting MQTT connection...");
+        if (mqttManager.connect())
         {
-            // Ensure MQTT is connected
-            if (!mqttManager.isConnected())
+            Serial.println("✅ MQTT connected!");
+            timeSeriesStore.requestUploadSinceLinkDown();
+            // The backend may have missed deltas while the link was down
+            statusReporter.sendSnapshot(systemClock().now());
+
+            // First connection after boot: the device now accepts commands
+            static bool bootProfileSent = false;
+            if (!bootProfileSent)
             {
-                Serial.println("🔗 Attempting MQTT connection...");
-                if (mqttManager.connect())
-                {
-                    Serial.println("✅ MQTT connected!");
-
-                    // Try to send credentials immediately after MQTT connection
-                    static bool credentialsChecked = false;
-                    if (!credentialsChecked)
-                    {
-                        checkAndSendCredentials();
-                        credentialsChecked = true;
-                    }
-                }
-                else
-                {
-                    Serial.println("❌ MQTT connection failed, will retry");
-                }
+                core.markBootPhase("mqtt");
+                core.printBootProfile();
+                mqttManager.sendBootProfile();
+                bootProfileSent = true;
             }
 
-            // Handle MQTT messages
-            mqttManager.loop();
-            relayController.checkRelayTimers();
-
-            // Send device status periodically
-            static unsigned long lastStatusUpdate = 0;
-            if (millis() - lastStatusUpdate > 30000)
-            { // Every 30 seconds
-                if (mqttManager.isConnected())
-                {
-                    mqttManager.sendDeviceStatus(core.getDeviceId(),
-                                                 relayController.getRelayStates(),
-                                                 relayController.getRelayTimers(),
-                                                 relayController.RELAY_COUNT);
-                    lastStatusUpdate = millis();
-                    Serial.println("📊 Device status sent to MQTT");
-                }
+            // Stalls recorded since the last report, including any that reset the device
+            if (loopWatchdog.hasReport())
+            {
+                JsonDocument report;
+                loopWatchdog.fillReport(report);
+                if (mqttManager.sendStallReport(report))
+                    loopWatchdog.clearReport();
             }
 
-            // Periodically check if we need to send credentials (if not already sent)
-            static unsigned long lastCredentialCheck = 0;
-            if (millis() - lastCredentialCheck > 60000 && !webInterface.areCredentialsSent())
+            // Try to send credentials immediately after MQTT connection
+            static bool credentialsChecked = false;
+            if (!credentialsChecked)
             {
                 checkAndSendCredentials();
-                lastCredentialCheck = millis();
+                credentialsChecked = true;
             }
         }
         else
         {
-            Serial.println("🚀 Starting Setup Mode...");
-            wifiManager.startSoftAP();
-            webInterface.initialize(preferencesManager, mqttManager, core);
-            Serial.println("📍 Setup Portal Ready at: http://192.168.4.1");
-            Serial.println("📶 Connect to WiFi: green-tech");
-            Serial.println("🔑 Password: 12345678");
-            // WiFi not connected, try to reconnect
-            Serial.println("📡 WiFi disconnected, attempting to reconnect...");
-            wifiManager.connectToWiFi();
+            Serial.println("❌ MQTT connection failed, will retry");
         }
     }
-}
\ No newline at end of file
+
+    // Handle MQTT messages
+    loopWatchdog.enter(LoopWatchdog::MQTT_LOOP);
+    mqttManager.loop();
+    return mqttManager.isConnected();
+}
+
+void loop()
+{
+    loopWatchdog.beginPass();
+
+    if (!core.isDeviceConfigured())
+    {
+        loopWatchdog.enter(LoopWatchdog::SETUP_MODE);
+        // In setup mode the web server runs on its own task; only a submitted config is applied here
+        configManager.loop(systemClock().now());
+        delay(10);
+        return;
+    }
+
+    bool online = maintainConnection();
+    // Readings taken from here on are backfilled once MQTT is back, whichever link failed
+    if (!online)
+        timeSeriesStore.markLinkDown();
+
+    // Everything from here to the wait is local control and runs whether or not the
+    // network is up; publishing steps check the connection themselves
+    loopWatchdog.enter(LoopWatchdog::CONFIG);
+    configManager.loop(systemClock().now());
+    loopWatchdog.enter(LoopWatchdog::RELAYS);
+    relayController.checkRelayTimers();
+    reportManualOverrides();
+    programRunner.loop(systemClock().now());
+    if (programRunner.takeStatusChange())
+    {
+        JsonDocument programStatus;
+        programRunner.fillStatus(programStatus, systemClock().now());
+        mqttManager.sendProgramStatus(programStatus);
+    }
+
+    // Apply commands the limiter deferred, newest per relay only
+    loopWatchdog.enter(LoopWatchdog::COMMANDS);
+    RelayCommand dueCommand;
+    while (commandLimiter.takeDueCommand(systemClock().now(), dueCommand))
+        applyRelayCommand(dueCommand);
+
+    RelaySnapshot relaySnapshot;
+    relayController.getSnapshot(relaySnapshot);
+    mqttManager.publishRelayStates(relaySnapshot.states, relayController.RELAY_COUNT);
+    timeSeriesStore.recordRelayStates(relaySnapshot.states, relayController.RELAY_COUNT);
+
+    // Send at most one history chunk per pass
+    loopWatchdog.enter(LoopWatchdog::HISTORY);
+    if (timeSeriesStore.hasPendingUpload() && online)
+    {
+        const uint8_t *chunkData;
+        size_t chunkSize;
+        uint32_t sequence;
+        if (timeSeriesStore.takeNextUploadChunk(chunkData, chunkSize, sequence))
+            mqttManager.sendHistoryChunk(timeSeriesStore.getBootId(), sequence, chunkData, chunkSize);
+    }
+
+    // Sample sensors (rules run on every sample) and publish a telemetry batch when one is due
+    loopWatchdog.enter(LoopWatchdog::SENSORS);
+    sensorManager.loop();
+    // A batch is cleared only once it was published; offline it keeps filling up to
+    // MAX_BATCH, and the history store holds every sample regardless
+    if (online && sensorManager.isBatchReady(systemClock().now()))
+    {
+        JsonDocument telemetry;
+        sensorManager.fillTelemetry(telemetry);
+        if (mqttManager.sendTelemetry(telemetry))
+            sensorManager.clearBatch(systemClock().now());
+        else
+            sensorManager.deferBatch(systemClock().now());
+    }
+
+    // Relay deltas once a burst settles; metrics ride along with the sparse heartbeat
+    loopWatchdog.enter(LoopWatchdog::STATUS);
+    if (statusReporter.loop(systemClock().now()))
+    {
+        sendMetrics();
+        Serial.println("💓 Heartbeat sent to MQTT");
+    }
+    // Reported state and remaining delta for the desired-state document
+    RelaySnapshot shadowSnapshot;
+    relayController.getSnapshot(shadowSnapshot);
+    if (online && shadowManager.isReportDue(shadowSnapshot.version))
+    {
+        JsonDocument reported;
+        shadowManager.fillReported(reported, shadowSnapshot, systemClock().now());
+        if (mqttManager.sendReportedState(reported))
+            shadowManager.markReported(shadowSnapshot.version);
+    }
+
+    // Report OTA progress from the download task
+    loopWatchdog.enter(LoopWatchdog::OTA);
+    if (otaManager.takeStatusChange())
+    {
+        mqttManager.sendOtaStatus(otaManager.getStateName(), otaManager.getBytesWritten(),
+                                  otaManager.getTotalSize(), otaManager.getRetries(),
+                                  otaManager.getError());
+        if (otaManager.shouldReboot())
+        {
+            Serial.println("🔄 Rebooting into new firmware...");
+            mqttManager.loop();
+            delay(500);
+            ESP.restart();
+        }
+    }
+
+    // Periodically check if we need to send credentials (if not already sent)
+    loopWatchdog.enter(LoopWatchdog::CREDENTIALS);
+    if (online && systemClock().now() - lastCredentialCheck >= CREDENTIAL_CHECK_INTERVAL_MS &&
+        !webInterface.areCredentialsSent())
+    {
+        checkAndSendCredentials();
+        lastCredentialCheck = systemClock().now();
+    }
+
+    // Sleep until the next relay deadline, status interval or incoming MQTT data
+    unsigned long now = systemClock().now();
+    unsigned long wait = relayController.getMillisUntilNextTimer(now);
+    if (timeSeriesStore.hasPendingUpload() && online)
+        wait = 0;
+    wait = min(wait, sensorManager.getMillisUntilNextSample(now));
+    wait = min(wait, commandLimiter.getMillisUntilNextDue(now));
+    wait = min(wait, configManager.getMillisUntilDue(now));
+    wait = min(wait, programRunner.getMillisUntilNextEvent(now));
+    wait = min(wait, wifiManager.getMillisUntilNextStep(now));
+    if (online)
+    {
+        wait = min(wait, statusReporter.getMillisUntilDue(now));
+        if (!webInterface.areCredentialsSent())
+            wait = min(wait, millisUntil(lastCredentialCheck, CREDENTIAL_CHECK_INTERVAL_MS, now));
+    }
+    else if (wifiManager.isConnected())
+    {
+        // While the broker is unreachable the loop also paces reconnects
+        wait = min(wait, millisUntil(lastMqttAttempt, MQTT_RETRY_INTERVAL_MS, now));
+    }
+    loopWatchdog.enter(LoopWatchdog::IDLE);
+    powerManager.waitForActivity(wifiClient, wait);
+}
@@ -0,0 +1,95 @@
+#ifndef NATIVE_STUB_ARDUINO_H
+#define NATIVE_STUB_ARDUINO_H
+
+// Just enough of the Arduino core for the hardware-independent modules to build in
+// [env:native]. Output is discarded, GPIO writes go nowhere and time comes from
+// systemClock(), so tests drive everything through a SimulatedClock.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+#include <limits.h>
+#include <algorithm>
+#include <string>
+#include <type_traits>
+
+using std::max;
+using std::min;
+
+// newlib has strlcpy; glibc only from 2.38
+#if defined(__GLIBC__) && (__GLIBC__ < 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ < 38))
+inline size_t strlcpy(char *destination, const char *source, size_t size)
+{
+    size_t length = strlen(source);
+    if (size)
+    {
+        size_t copied = length < size - 1 ? length : size - 1;
+        memcpy(destination, source, copied);
+        destination[copied] = '\0';
+    }
+    return length;
+}
+#endif
+
+class String
+{
+public:
+    String(const char *text = "") : value(text ? text : "") {}
+    String(const std::string &text) : value(text) {}
+    template <typename T, typename std::enable_if<std::is_integral<T>::value, int>::type = 0>
+    String(T number) : value(std::to_string(number)) {}
+    String(double number, int decimals = 2)
+    {
+        char buffer[32];
+        snprintf(buffer, sizeof(buffer), "%.*f", decimals, number);
+        value = buffer;
+    }
+
+    const char *c_str() const { return value.c_str(); }
+    unsigned int length() const { return value.length(); }
+    bool operator==(const String &other) const { return value == other.value; }
+    bool operator!=(const String &other) const { return value != other.value; }
+    String &operator+=(const String &other)
+    {
+        value += other.value;
+        return *this;
+    }
+    friend String operator+(String left, const String &right) { return left += right; }
+
+private:
+    std::string value;
+};
+
+struct NativeSerial
+{
+    void begin(unsigned long) {}
+    template <typename T> void print(const T &) {}
+    template <typename T> void println(const T &) {}
+    void println() {}
+};
+static NativeSerial Serial;
+
+#define OUTPUT 0x03
+#define INPUT 0x01
+#define INPUT_PULLUP 0x05
+#define LOW 0
+#define HIGH 1
+#define IRAM_ATTR
+
+inline void pinMode(uint8_t, uint8_t) {}
+inline void digitalWrite(uint8_t, uint8_t) {}
+inline int digitalRead(uint8_t) { return LOW; }
+
+template <typename T> T constrain(T value, T low, T high)
+{
+    return value < low ? low : value > high ? high : value;
+}
+
+typedef int portMUX_TYPE;
+#define portMUX_INITIALIZER_UNLOCKED 0
+#define portENTER_CRITICAL(mux) ((void)(mux))
+#define portEXIT_CRITICAL(mux) ((void)(mux))
+
+#endif
@@ -0,0 +1,10 @@
+#ifndef NATIVE_STUB_GPIO_H
+#define NATIVE_STUB_GPIO_H
+
+#include <stdint.h>
+
+typedef int gpio_num_t;
+
+inline int gpio_set_level(gpio_num_t, uint32_t) { return 0; }
+
+#endif
@@ -0,0 +1,38 @@
+#ifndef NATIVE_STUB_ESP_TIMER_H
+#define NATIVE_STUB_ESP_TIMER_H
+
+// esp_timer for [env:native]: timers are accepted but never fire, and the microsecond
+// clock follows systemClock() so it moves with a SimulatedClock
+
+#include <stdint.h>
+#include "Clock/Clock.h"
+
+typedef int esp_err_t;
+#define ESP_OK 0
+
+typedef struct NativeTimer *esp_timer_handle_t;
+typedef void (*esp_timer_cb_t)(void *arg);
+typedef enum
+{
+    ESP_TIMER_TASK
+} esp_timer_dispatch_t;
+
+typedef struct
+{
+    esp_timer_cb_t callback;
+    void *arg;
+    esp_timer_dispatch_t dispatch_method;
+    const char *name;
+    bool skip_unhandled_events;
+} esp_timer_create_args_t;
+
+inline esp_err_t esp_timer_create(const esp_timer_create_args_t *, esp_timer_handle_t *handle)
+{
+    *handle = nullptr;
+    return ESP_OK;
+}
+inline esp_err_t esp_timer_start_once(esp_timer_handle_t, uint64_t) { return ESP_OK; }
+inline esp_err_t esp_timer_stop(esp_timer_handle_t) { return ESP_OK; }
+inline int64_t esp_timer_get_time() { return (int64_t)systemClock().now() * 1000; }
+
+#endif
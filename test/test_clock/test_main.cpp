@@ -0,0 +1,85 @@
+#include <unity.h>
+#include "Clock/Clock.h"
+#include "Clock/SimulatedClock.h"
+#include "RelayController/RelayController.h"
+
+// Start a minute below the wrap. unsigned long is 32 bits on the ESP32, where this is the
+// 49.7-day millis() rollover; the host type is wider, but wraps the same way.
+static const unsigned long BEFORE_WRAP = ~0UL - 60000;
+
+static SimulatedClock simulated;
+
+void setUp()
+{
+    simulated.set(BEFORE_WRAP);
+    setSystemClock(simulated);
+}
+
+void tearDown() {}
+
+static void test_simulated_clock_wraps()
+{
+    simulated.advance(60000);
+    TEST_ASSERT_EQUAL_UINT64(~0UL, simulated.now());
+    simulated.advance(1);
+    TEST_ASSERT_EQUAL_UINT64(0, simulated.now());
+    simulated.advance(5000);
+    TEST_ASSERT_EQUAL_UINT64(5000, systemClock().now());
+}
+
+static void test_deadline_across_wrap()
+{
+    unsigned long deadline = systemClock().now() + 90000; // lands after the wrap
+    TEST_ASSERT_TRUE(deadline < systemClock().now());     // why < and >= must not be used
+
+    TEST_ASSERT_FALSE(Clock::hasReached(systemClock().now(), deadline));
+    TEST_ASSERT_EQUAL_UINT64(90000, Clock::getRemaining(systemClock().now(), deadline));
+
+    // Step across the wrap a second at a time; the remaining time must fall steadily
+    for (unsigned long elapsed = 1000; elapsed < 90000; elapsed += 1000)
+    {
+        simulated.advance(1000);
+        TEST_ASSERT_FALSE(Clock::hasReached(systemClock().now(), deadline));
+        TEST_ASSERT_EQUAL_UINT64(90000 - elapsed, Clock::getRemaining(systemClock().now(), deadline));
+    }
+
+    simulated.advance(1000);
+    TEST_ASSERT_TRUE(Clock::hasReached(systemClock().now(), deadline));
+    TEST_ASSERT_EQUAL_UINT64(0, Clock::getRemaining(systemClock().now(), deadline));
+
+    // A deadline in the past stays reached after the wrap
+    simulated.advance(3600000);
+    TEST_ASSERT_TRUE(Clock::hasReached(systemClock().now(), deadline));
+}
+
+static void test_relay_timer_across_wrap()
+{
+    relayController.initialize();
+    relayController.setRelayTimer(3, 120); // two minutes, ends after the wrap
+    TEST_ASSERT_TRUE(relayController.getRelayState(3));
+    TEST_ASSERT_EQUAL_UINT64(120000, relayController.getMillisUntilNextTimer(systemClock().now()));
+
+    simulated.advance(60001); // just past the wrap
+    relayController.checkRelayTimers();
+    TEST_ASSERT_TRUE(relayController.getRelayState(3));
+    TEST_ASSERT_EQUAL_UINT64(59999, relayController.getMillisUntilNextTimer(systemClock().now()));
+
+    simulated.advance(59998);
+    relayController.checkRelayTimers();
+    TEST_ASSERT_TRUE(relayController.getRelayState(3));
+
+    simulated.advance(1);
+    relayController.checkRelayTimers();
+    TEST_ASSERT_FALSE(relayController.getRelayState(3));
+    TEST_ASSERT_EQUAL_UINT64(0, relayController.getRelayTimer(3));
+    TEST_ASSERT_EQUAL_UINT64(ULONG_MAX, relayController.getMillisUntilNextTimer(systemClock().now()));
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_simulated_clock_wraps);
+    RUN_TEST(test_deadline_across_wrap);
+    RUN_TEST(test_relay_timer_across_wrap);
+    return UNITY_END();
+}
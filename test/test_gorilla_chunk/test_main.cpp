@@ -0,0 +1,165 @@
+#include <unity.h>
+#include <string.h>
+#include "TimeSeriesStore/GorillaChunk.h"
+
+// Minimal reader for the chunk format, mirroring tools/history/decode_history.py
+class ChunkReader
+{
+public:
+    explicit ChunkReader(const GorillaChunk &chunk)
+        : payload(chunk.data() + sizeof(GorillaChunk::Header)), bitCount(chunk.header().bitCount)
+    {
+        memset(states, 0, sizeof(states));
+    }
+
+    bool next(uint8_t &series, uint32_t &timestamp, uint32_t &value)
+    {
+        series = read(3);
+        State &s = states[series];
+        if (!s.seen)
+        {
+            s.seen = true;
+            s.timestamp = read(32);
+            s.value = read(32);
+        }
+        else
+        {
+            int32_t dod;
+            if (read(1) == 0)
+                dod = 0;
+            else if (read(1) == 0)
+                dod = signExtend(read(7), 7);
+            else if (read(1) == 0)
+                dod = signExtend(read(9), 9);
+            else if (read(1) == 0)
+                dod = signExtend(read(12), 12);
+            else
+                dod = (int32_t)read(32);
+            s.delta += dod;
+            s.timestamp += s.delta;
+
+            if (read(1) == 1)
+            {
+                uint32_t meaningful;
+                if (read(1) == 0)
+                {
+                    meaningful = read(32 - s.leading - s.trailing);
+                }
+                else
+                {
+                    s.leading = read(5);
+                    int length = read(6) + 1;
+                    s.trailing = 32 - s.leading - length;
+                    meaningful = read(length);
+                }
+                s.value ^= meaningful << s.trailing;
+            }
+        }
+        timestamp = s.timestamp;
+        value = s.value;
+        return !overrun;
+    }
+
+private:
+    struct State
+    {
+        bool seen;
+        uint32_t timestamp;
+        int32_t delta;
+        uint32_t value;
+        int leading;
+        int trailing;
+    };
+
+    uint32_t read(int bits)
+    {
+        uint32_t value = 0;
+        for (int i = 0; i < bits; i++)
+        {
+            if (pos >= bitCount)
+                overrun = true;
+            int bit = (payload[pos >> 3] >> (7 - (pos & 7))) & 1;
+            value = (value << 1) | bit;
+            pos++;
+        }
+        return value;
+    }
+
+    static int32_t signExtend(uint32_t value, int bits)
+    {
+        return value & (1UL << (bits - 1)) ? (int32_t)(value - (1UL << bits)) : (int32_t)value;
+    }
+
+    const uint8_t *payload;
+    uint32_t bitCount;
+    uint32_t pos = 0;
+    bool overrun = false;
+    State states[GorillaChunk::MAX_SERIES];
+};
+
+static GorillaChunk chunk;
+
+void setUp() {}
+void tearDown() {}
+
+static void assertRoundTrip(const uint32_t *timestamps, const uint32_t *values, int count)
+{
+    chunk.reset(1, 2, timestamps[0]);
+    for (int i = 0; i < count; i++)
+        TEST_ASSERT_TRUE(chunk.append(1, timestamps[i], values[i]));
+
+    ChunkReader reader(chunk);
+    for (int i = 0; i < count; i++)
+    {
+        uint8_t series;
+        uint32_t timestamp, value;
+        TEST_ASSERT_TRUE(reader.next(series, timestamp, value));
+        TEST_ASSERT_EQUAL_UINT8(1, series);
+        TEST_ASSERT_EQUAL_UINT32(timestamps[i], timestamp);
+        TEST_ASSERT_EQUAL_UINT32(values[i], value);
+    }
+}
+
+// Each bucket's extremes, on both sides: a wrongly signed field corrupts every later timestamp
+static void test_timestamp_bucket_edges()
+{
+    const int32_t dods[] = {63, 64, -64, -65, 255, 256, -256, -257, 2047, 2048, -2048, -2049, 0, 1, -1};
+    const int count = sizeof(dods) / sizeof(dods[0]) + 2;
+    uint32_t timestamps[count];
+    uint32_t values[count];
+    // A large, steady delta keeps every timestamp increasing whatever the dod
+    int32_t delta = 10000;
+    timestamps[0] = 1000;
+    timestamps[1] = timestamps[0] + delta;
+    for (int i = 2; i < count; i++)
+    {
+        delta += dods[i - 2];
+        timestamps[i] = timestamps[i - 1] + delta;
+    }
+    for (int i = 0; i < count; i++)
+        values[i] = 200 + i * 3;
+    assertRoundTrip(timestamps, values, count);
+}
+
+static void test_reported_sequence()
+{
+    const uint32_t timestamps[] = {1000, 2000, 3064, 4384, 7752};
+    const uint32_t values[] = {5, 5, 6, 6, 900};
+    assertRoundTrip(timestamps, values, 5);
+}
+
+static void test_timestamp_wrap()
+{
+    const uint32_t timestamps[] = {0xFFFFF000UL, 0xFFFFF800UL, 0x00000010UL, 0x00000900UL};
+    const uint32_t values[] = {1, 2, 3, 4};
+    assertRoundTrip(timestamps, values, 4);
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_timestamp_bucket_edges);
+    RUN_TEST(test_reported_sequence);
+    RUN_TEST(test_timestamp_wrap);
+    return UNITY_END();
+}
@@ -0,0 +1,171 @@
+#include <unity.h>
+#include "Clock/SimulatedClock.h"
+#include "SensorManager/SensorManager.h"
+#include "SensorManager/SimulatedSampleSource.h"
+
+static const unsigned long SAMPLE_MS = 1000;
+static const unsigned long BATCH_MS = 10000;
+static const int BATCH_SAMPLES = BATCH_MS / SAMPLE_MS;
+// (3000 - raw) * 100 / 1800: 2100 is 50 %, 1200 is 100 %
+static const uint16_t HALF_WET_RAW = 2100;
+static const uint16_t WET_RAW = 1200;
+
+static SimulatedClock simulated;
+static SimulatedSampleSource source;
+static SensorManager sensors;
+static int readings;
+
+static void onReading(const SensorReading &)
+{
+    readings++;
+}
+
+// One DMA drain (8 raw samples per channel from the simulated source) per sample interval
+static void step()
+{
+    simulated.advance(SAMPLE_MS);
+    sensors.loop();
+}
+
+void setUp()
+{
+    simulated.set(100000);
+    setSystemClock(simulated);
+    source = SimulatedSampleSource();
+    source.setMoistureRaw(HALF_WET_RAW);
+    sensors = SensorManager();
+    sensors.initialize(source, SAMPLE_MS, BATCH_MS);
+    sensors.setSampleCallback(onReading);
+    readings = 0;
+}
+
+void tearDown() {}
+
+static void test_oversampled_mean_is_one_reading_per_interval()
+{
+    // Draining between intervals only accumulates
+    simulated.advance(SAMPLE_MS / 2);
+    sensors.loop();
+    TEST_ASSERT_EQUAL_INT(0, readings);
+
+    simulated.advance(SAMPLE_MS / 2);
+    sensors.loop();
+    TEST_ASSERT_EQUAL_INT(1, readings);
+    TEST_ASSERT_EQUAL_UINT64(simulated.now(), sensors.getLatestReading().timestamp);
+    // 16 raw samples with ±16 counts of noise average out to well under 1 %
+    TEST_ASSERT_FLOAT_WITHIN(1.0f, 50.0f, sensors.getLatestReading().soilMoisture);
+    TEST_ASSERT_EQUAL_UINT64(SAMPLE_MS, sensors.getMillisUntilNextSample(simulated.now()));
+}
+
+static void test_median_rejects_a_single_spike()
+{
+    for (int i = 0; i < SensorManager::MEDIAN_WINDOW; i++)
+        step();
+    float settled = sensors.getLatestReading().soilMoisture;
+
+    source.setMoistureRaw(WET_RAW);
+    step();
+    source.setMoistureRaw(HALF_WET_RAW);
+    step();
+    TEST_ASSERT_FLOAT_WITHIN(1.0f, settled, sensors.getLatestReading().soilMoisture);
+}
+
+static void test_ema_follows_a_step_gradually()
+{
+    for (int i = 0; i < SensorManager::MEDIAN_WINDOW; i++)
+        step();
+
+    source.setMoistureRaw(WET_RAW);
+    float previous = sensors.getLatestReading().soilMoisture;
+    // The median needs a majority of the window before the step shows at all
+    for (int i = 0; i < SensorManager::MEDIAN_WINDOW / 2; i++)
+    {
+        step();
+        TEST_ASSERT_FLOAT_WITHIN(1.0f, previous, sensors.getLatestReading().soilMoisture);
+    }
+
+    // Then the EMA closes 30 % of the remaining gap per reading
+    step();
+    float first = sensors.getLatestReading().soilMoisture;
+    TEST_ASSERT_FLOAT_WITHIN(2.0f, previous + 0.3f * (100.0f - previous), first);
+    previous = first;
+    for (int i = 0; i < 20; i++)
+    {
+        step();
+        TEST_ASSERT_TRUE(sensors.getLatestReading().soilMoisture >= previous);
+        previous = sensors.getLatestReading().soilMoisture;
+    }
+    TEST_ASSERT_FLOAT_WITHIN(1.0f, 100.0f, previous);
+}
+
+static void test_flow_rate_from_pulses()
+{
+    // 450 pulses per litre: 75 pulses per second is 10 L/min
+    source.setFlowPulsesPerRead(75);
+    step();
+    TEST_ASSERT_FLOAT_WITHIN(0.01f, 10.0f, sensors.getLatestReading().flowRate);
+}
+
+static void test_batch_assembly()
+{
+    unsigned long first = simulated.now() + SAMPLE_MS;
+    for (int i = 0; i < BATCH_SAMPLES - 1; i++)
+    {
+        step();
+        TEST_ASSERT_FALSE(sensors.isBatchReady(simulated.now()));
+    }
+    step();
+    TEST_ASSERT_TRUE(sensors.isBatchReady(simulated.now()));
+
+    JsonDocument doc;
+    sensors.fillTelemetry(doc);
+    TEST_ASSERT_EQUAL_UINT64(first, doc["t0"].as<unsigned long>());
+    TEST_ASSERT_EQUAL_UINT64(SAMPLE_MS, doc["dt"].as<unsigned long>());
+    TEST_ASSERT_EQUAL_INT(BATCH_SAMPLES, doc["m"].size());
+    TEST_ASSERT_EQUAL_INT(BATCH_SAMPLES, doc["t"].size());
+    TEST_ASSERT_EQUAL_INT(BATCH_SAMPLES, doc["f"].size());
+    // Moisture travels in 0.1 % steps
+    TEST_ASSERT_INT_WITHIN(1, (int)(sensors.getLatestReading().soilMoisture * 10),
+                           doc["m"][BATCH_SAMPLES - 1].as<int>());
+
+    sensors.clearBatch(simulated.now());
+    TEST_ASSERT_FALSE(sensors.isBatchReady(simulated.now()));
+    step();
+    JsonDocument next;
+    sensors.fillTelemetry(next);
+    TEST_ASSERT_EQUAL_INT(1, next["m"].size());
+    TEST_ASSERT_EQUAL_UINT64(simulated.now(), next["t0"].as<unsigned long>());
+}
+
+static void test_full_batch_goes_early_and_waits_after_a_failed_publish()
+{
+    sensors.setIntervals(SAMPLE_MS, 3600000);
+    for (int i = 0; i < SensorManager::MAX_BATCH - 1; i++)
+        step();
+    TEST_ASSERT_FALSE(sensors.isBatchReady(simulated.now()));
+    step();
+    TEST_ASSERT_TRUE(sensors.isBatchReady(simulated.now()));
+
+    // Publish failed: keep the samples, but do not retry on every loop
+    sensors.deferBatch(simulated.now());
+    step();
+    TEST_ASSERT_FALSE(sensors.isBatchReady(simulated.now()));
+    JsonDocument doc;
+    sensors.fillTelemetry(doc);
+    TEST_ASSERT_EQUAL_INT(SensorManager::MAX_BATCH, doc["m"].size());
+
+    simulated.advance(3600000);
+    TEST_ASSERT_TRUE(sensors.isBatchReady(simulated.now()));
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_oversampled_mean_is_one_reading_per_interval);
+    RUN_TEST(test_median_rejects_a_single_spike);
+    RUN_TEST(test_ema_follows_a_step_gradually);
+    RUN_TEST(test_flow_rate_from_pulses);
+    RUN_TEST(test_batch_assembly);
+    RUN_TEST(test_full_batch_goes_early_and_waits_after_a_failed_publish);
+    return UNITY_END();
+}
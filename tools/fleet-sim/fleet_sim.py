@@ -0,0 +1,1043 @@
+#!/usr/bin/env python3
+"""
+GreenTech fleet simulator and broker load-test harness.
+
+Runs N virtual relay controllers in one process against a local broker
+(mosquitto). Every virtual device speaks the same MQTT protocol as the
+firmware in src/:
+
+  - subscribes to green-tech/relay-control, green-tech/relay-emergency,
+    its own green-tech/<deviceId>/config and .../desired, and one
+    green-tech/group/<name>/relay-control topic per group it belongs to
+  - ignores direct commands for other device IDs before parsing; group
+    topics accept relay commands and emergency stops only
+  - runs relay commands through a copy of CommandLimiter: a global token
+    bucket (20/s, burst 40) drops messages, per-relay buckets (2/s, burst 4)
+    and a 250 ms minimum switch interval defer them, and deferred commands
+    coalesce per relay so only the last one of a burst is applied. Group
+    stagger is a limiter delay, so a staggered command can be coalesced too
+  - takes all-off, stop, and off on the emergency topic or with priority
+    emergency past the limiter, dropping deferred commands for those relays;
+    the emergency topic ignores everything else
+  - answers action "query" (snapshot, relays, config, metrics) on the
+    requester's green-tech/<id>/response topic with its correlationId
+  - reconciles the retained desired-state document like ShadowManager and
+    publishes green-tech/<deviceId>/reported, retained
+  - answers a command carrying a traceId with a relay-status message
+    holding the trace; untraced changes go out as a debounced
+    green-tech/status-delta
+  - publishes a green-tech/device-status snapshot on connect, then only a
+    sparse green-tech/heartbeat while nothing changes
+  - applies heartbeatMs and groups from its config topic and answers on
+    green-tech/config-status
+
+A backend driver assigns groups over the config topic, publishes direct and
+group command storms with a share of emergency stops and queries, pushes
+desired-state versions and triggers reconnect waves. It matches traced
+relay-status replies by traceId and query responses by correlationId to
+report latency percentiles, and counts delta, heartbeat, reported and
+config traffic. Traced commands that the limiter coalesced away or dropped
+never get a reply; they are counted as lost, as they would be on a device.
+Pulse patterns, programs, rules and manual inputs are not simulated.
+
+    pip install paho-mqtt
+    mosquitto -v &
+    python3 tools/fleet-sim/fleet_sim.py --devices 200 --storm-rate 500 --groups 4
+"""
+
+import argparse
+import json
+import random
+import threading
+import time
+import zlib
+from collections import defaultdict
+
+import paho.mqtt.client as mqtt
+
+TOPIC_RELAY_CONTROL = "green-tech/relay-control"
+TOPIC_RELAY_EMERGENCY = "green-tech/relay-emergency"
+TOPIC_RELAY_STATUS = "green-tech/relay-status"
+TOPIC_DEVICE_STATUS = "green-tech/device-status"
+TOPIC_STATUS_DELTA = "green-tech/status-delta"
+TOPIC_HEARTBEAT = "green-tech/heartbeat"
+TOPIC_CONFIG_STATUS = "green-tech/config-status"
+TOPIC_BACKEND_RESPONSE = "green-tech/sim-backend/response"
+RELAY_COUNT = 20
+ALL_RELAYS = (1 << RELAY_COUNT) - 1
+RELAY_ACTIONS = ("on", "off", "toggle", "timer")
+GLOBAL_RATE_PER_S = 20.0   # CommandLimiter::GLOBAL_RATE_PER_S
+GLOBAL_BURST = 40.0        # CommandLimiter::GLOBAL_BURST
+RELAY_RATE_PER_S = 2.0     # CommandLimiter::RELAY_RATE_PER_S
+RELAY_BURST = 4.0          # CommandLimiter::RELAY_BURST
+MIN_SWITCH_INTERVAL_MS = 250  # CommandLimiter::MIN_SWITCH_INTERVAL_MS
+MAX_TIMER_S = 86400        # ShadowManager::MAX_TIMER_S
+MAX_REPLY_TOPIC_LENGTH = 128  # MQTTManager::MAX_REPLY_TOPIC_LENGTH
+DEBOUNCE_MS = 250          # StatusReporter::DEBOUNCE_MS
+MIN_HEARTBEAT_MS = 10000   # ConfigManager::MIN_HEARTBEAT_MS
+MAX_HEARTBEAT_MS = 3600000 # ConfigManager::MAX_HEARTBEAT_MS
+MAX_STAGGER_MS = 600000    # GroupManager::MAX_STAGGER_MS
+MAX_GROUPS = 8             # GroupManager::MAX_GROUPS
+
+
+def make_client(client_id):
+    # paho-mqtt 2.x requires the callback API version, 1.x rejects it
+    if hasattr(mqtt, "CallbackAPIVersion"):
+        return mqtt.Client(mqtt.CallbackAPIVersion.VERSION1, client_id=client_id)
+    return mqtt.Client(client_id=client_id)
+
+
+def group_topic(name):
+    return "green-tech/group/%s/relay-control" % name
+
+
+def dumps(doc):
+    return json.dumps(doc, separators=(",", ":"))
+
+
+def is_response_topic(topic):
+    """MQTTManager::isResponseTopic: green-tech/<requester>/response[/...] only."""
+    if len(topic) > MAX_REPLY_TOPIC_LENGTH or "+" in topic or "#" in topic:
+        return False
+    parts = topic.split("/")
+    return len(parts) >= 3 and parts[0] == "green-tech" and parts[1] != "" and parts[2] == "response"
+
+
+def decode_command(doc):
+    """RelayCommand::decode; None when the action is not a relay command."""
+    if doc.get("action") not in RELAY_ACTIONS:
+        return None
+    try:
+        relay = int(doc.get("relay", -1))
+        duration = int(doc.get("duration", 0))
+    except (TypeError, ValueError):
+        return None
+    command = {"relay": relay, "action": doc["action"], "duration": duration}
+    if doc.get("traceId"):
+        command["traceId"] = doc["traceId"]
+        command["sentAt"] = doc.get("sentAt")
+    return command
+
+
+def is_emergency(topic, doc, action):
+    """Only commands that switch off take the emergency lane."""
+    if action in ("all-off", "stop"):
+        return True
+    return action == "off" and (topic == TOPIC_RELAY_EMERGENCY or doc.get("priority") == "emergency")
+
+
+def may_be_emergency(payload):
+    """Pre-parse check from mqttCallback; a false positive is charged after the parse."""
+    if b"all-off" in payload or b'"stop"' in payload:
+        return True
+    return b"emergency" in payload and b'"off"' in payload
+
+
+class TokenBucket:
+    def __init__(self, tokens, now):
+        self.tokens = tokens
+        self.last_refill = now
+
+    def refill(self, now, rate_per_s, burst):
+        self.tokens = min(burst, self.tokens + (now - self.last_refill) * rate_per_s / 1000.0)
+        self.last_refill = now
+
+    def millis_until_token(self, rate_per_s):
+        return 0 if self.tokens >= 1.0 else int((1.0 - self.tokens) * 1000.0 / rate_per_s) + 1
+
+
+class CommandLimiter:
+    """Mirrors src/CommandLimiter: the same buckets, switch interval and coalescing."""
+
+    APPLY_NOW, DEFERRED, DROPPED = range(3)
+
+    def __init__(self, now):
+        self.global_bucket = TokenBucket(GLOBAL_BURST, now)
+        self.relay_buckets = [TokenBucket(RELAY_BURST, now) for _ in range(RELAY_COUNT)]
+        self.last_switch = [None] * RELAY_COUNT
+        self.pending = [None] * RELAY_COUNT   # (command, since, delay) per relay
+        self.metrics = {"applied": 0, "dropped": 0, "deferred": 0, "coalesced": 0, "staggered": 0}
+
+    def admit_message(self, now):
+        self.global_bucket.refill(now, GLOBAL_RATE_PER_S, GLOBAL_BURST)
+        if self.global_bucket.tokens < 1.0:
+            self.metrics["dropped"] += 1
+            return False
+        self.global_bucket.tokens -= 1.0
+        return True
+
+    def relay_ready(self, relay, now):
+        self.relay_buckets[relay].refill(now, RELAY_RATE_PER_S, RELAY_BURST)
+        last = self.last_switch[relay]
+        interval_elapsed = last is None or now - last >= MIN_SWITCH_INTERVAL_MS
+        return interval_elapsed and self.relay_buckets[relay].tokens >= 1.0
+
+    def mark_applied(self, relay, now):
+        self.relay_buckets[relay].tokens -= 1.0
+        self.last_switch[relay] = now
+        self.metrics["applied"] += 1
+
+    def submit(self, command, now, delay_ms=0):
+        relay = command["relay"]
+        if relay < 0 or relay >= RELAY_COUNT:
+            self.metrics["dropped"] += 1
+            return self.DROPPED
+        if delay_ms == 0 and self.pending[relay] is None and self.relay_ready(relay, now):
+            self.mark_applied(relay, now)
+            return self.APPLY_NOW
+        # Last command wins: a newer one replaces whatever is still waiting for this relay
+        self.metrics["coalesced" if self.pending[relay] is not None else "deferred"] += 1
+        if delay_ms > 0:
+            self.metrics["staggered"] += 1
+        self.pending[relay] = (command, now, delay_ms)
+        return self.DEFERRED
+
+    def take_due_command(self, now):
+        for relay, entry in enumerate(self.pending):
+            if entry is not None and now - entry[1] >= entry[2] and self.relay_ready(relay, now):
+                self.pending[relay] = None
+                self.mark_applied(relay, now)
+                return entry[0]
+        return None
+
+    def get_pending_command(self, relay):
+        entry = self.pending[relay]
+        return entry[0] if entry is not None else None
+
+    def cancel_pending(self, relay):
+        self.pending[relay] = None
+
+
+class Counters:
+    def __init__(self):
+        self.lock = threading.Lock()
+        self.values = defaultdict(int)
+
+    def add(self, name, amount=1):
+        with self.lock:
+            self.values[name] += amount
+
+    def snapshot(self):
+        with self.lock:
+            return dict(self.values)
+
+
+class VirtualDevice:
+    """Mirrors Core, MQTTManager, RelayController, CommandLimiter, StatusReporter,
+    ShadowManager and GroupManager."""
+
+    def __init__(self, index, args, counters):
+        self.device_id = "GT-sim%05x" % index
+        self.args = args
+        self.counters = counters
+        self.start = time.monotonic()
+        self.relay_states = [False] * RELAY_COUNT
+        self.relay_timers = [0] * RELAY_COUNT
+        self.version = 0
+        self.reported = None          # (version, states, timers) the backend last heard about
+        self.change_seen_at = None    # Start of the delta debounce window
+        self.last_heartbeat = 0
+        self.heartbeat_ms = args.heartbeat_ms
+        self.groups = []
+        self.stagger_hash = zlib.crc32(self.device_id.encode())
+        self.limiter = CommandLimiter(0)
+        self.desired = None           # (version, mask, {relay: seconds}) from .../desired
+        self.applied_desired = 0      # Version whose timers already ran
+        self.held_mask = 0            # Switched locally since the desired version arrived
+        self.shadow_report_pending = False
+        self.shadow_reported_version = None
+        self.lock = threading.RLock()
+        self.client = make_client(self.device_id)
+        self.client.will_set(self.topic("status"), "offline", qos=1, retain=True)
+        self.client.on_connect = self.on_connect
+        self.client.on_message = self.on_message
+
+    def topic(self, suffix):
+        return "green-tech/%s/%s" % (self.device_id, suffix)
+
+    def millis(self):
+        return int((time.monotonic() - self.start) * 1000)
+
+    def micros(self):
+        return int((time.monotonic() - self.start) * 1000000)
+
+    def start_device(self):
+        self.client.connect_async(self.args.host, self.args.port, keepalive=15)
+        self.client.loop_start()
+
+    def stop_device(self):
+        self.client.loop_stop()
+        self.client.disconnect()
+
+    def reconnect(self):
+        self.counters.add("reconnects")
+        self.client.disconnect()
+        self.client.reconnect()
+
+    def on_connect(self, client, userdata, flags, rc):
+        if rc != 0:
+            self.counters.add("connect_failures")
+            return
+        client.publish(self.topic("status"), "online", qos=1, retain=True)
+        client.subscribe(TOPIC_RELAY_CONTROL)
+        client.subscribe(TOPIC_RELAY_EMERGENCY, 1)
+        client.subscribe(self.topic("config"), 1)
+        client.subscribe(self.topic("desired"), 1)
+        with self.lock:
+            groups = list(self.groups)
+        for name in groups:
+            client.subscribe(group_topic(name))
+        self.counters.add("connects")
+        # State may have changed while offline: a full snapshot becomes the new baseline
+        self.send_device_status()
+
+    def on_message(self, client, userdata, msg):
+        """Same order of checks as mqttCallback() in src/main.cpp."""
+        self.counters.add("device_rx")
+        received_at = self.micros()
+        payload = msg.payload
+
+        if msg.topic == self.topic("config"):
+            doc = self.parse(payload)
+            if doc is not None:
+                self.apply_config(doc)
+            return
+        if msg.topic == self.topic("desired"):
+            self.set_desired(payload)
+            return
+
+        # Messages for other devices are skipped before the parse; the group subscription
+        # itself is the address
+        group_message = msg.topic.startswith("green-tech/group/")
+        if not group_message and self.device_id.encode() not in payload:
+            return
+
+        emergency_topic = msg.topic == TOPIC_RELAY_EMERGENCY
+        suspected = not emergency_topic and may_be_emergency(payload)
+        if not emergency_topic and not suspected and not self.admit_message():
+            return
+
+        doc = self.parse(payload)
+        if doc is None:
+            doc = {}
+        if not group_message and doc.get("deviceId") != self.device_id:
+            return
+        action = doc.get("action")
+
+        if is_emergency(msg.topic, doc, action):
+            self.apply_emergency(doc, action, received_at)
+            return
+        if emergency_topic:
+            self.counters.add("emergency_ignored")
+            return
+        if suspected and not self.admit_message():
+            return
+
+        if group_message:
+            self.submit_command(doc, received_at, self.stagger_delay(doc))
+            return
+        if action == "query":
+            self.handle_query(doc)
+            return
+        self.submit_command(doc, received_at, 0)
+
+    @staticmethod
+    def parse(payload):
+        try:
+            doc = json.loads(payload)
+        except ValueError:
+            return None
+        return doc if isinstance(doc, dict) else None
+
+    def admit_message(self):
+        with self.lock:
+            admitted = self.limiter.admit_message(self.millis())
+        if not admitted:
+            self.counters.add("limiter_dropped")
+        return admitted
+
+    def stagger_delay(self, doc):
+        explicit = (doc.get("stagger") or {}).get(self.device_id)
+        if explicit is not None:
+            delay = int(explicit)
+        else:
+            window = min(int(doc.get("staggerMs", 0)), MAX_STAGGER_MS)
+            delay = self.stagger_hash % (window + 1) if window > 0 else 0
+        return min(delay, MAX_STAGGER_MS)
+
+    def submit_command(self, doc, received_at, stagger):
+        command = decode_command(doc)
+        if command is None:
+            return
+        command["receivedAt"] = received_at
+        command["decodedAt"] = self.micros()
+        with self.lock:
+            # Toggles are resolved on arrival so a coalesced toggle keeps its meaning
+            if command["action"] == "toggle":
+                current = self.relay_states[command["relay"]]
+                pending = self.limiter.get_pending_command(command["relay"])
+                if pending is not None:
+                    current = pending["action"] != "off"
+                command["action"] = "off" if current else "on"
+            result = self.limiter.submit(command, self.millis(), stagger)
+        if result == CommandLimiter.APPLY_NOW:
+            self.apply_command(command, deferred=False)
+        elif result == CommandLimiter.DROPPED:
+            self.counters.add("limiter_dropped")
+
+    def apply_command(self, command, deferred):
+        relay = command["relay"]
+        action = command["action"]
+        with self.lock:
+            if action == "on":
+                self.set_relay(relay, True, 0)
+            elif action == "off":
+                self.set_relay(relay, False, 0)
+            elif action == "timer":
+                duration = command["duration"]
+                self.set_relay(relay, True, self.millis() + duration * 1000 if duration else 0)
+            state = self.relay_states[relay]
+            timer = self.relay_timers[relay]
+            version = self.version
+        applied_at = self.micros()
+
+        trace_id = command.get("traceId")
+        if not trace_id:
+            return  # Reported by the debounced delta
+        received_at = command["receivedAt"]
+        trace = {
+            "id": trace_id,
+            "relay": relay,
+            "rxUs": received_at,
+            "decodeUs": command["decodedAt"] - received_at,
+            "applyUs": applied_at - command["decodedAt"],
+            "deferred": deferred,
+        }
+        if command.get("sentAt"):
+            trace["sentAt"] = command["sentAt"]
+        self.publish(TOPIC_RELAY_STATUS, {
+            "deviceId": self.device_id,
+            "relay": relay,
+            "state": state,
+            "timer": timer,
+            "version": version,
+            "timestamp": self.millis(),
+            "trace": trace,
+        })
+
+    def apply_emergency(self, doc, action, received_at):
+        self.counters.add("emergencies")
+        if action == "all-off":
+            with self.lock:
+                for i in range(RELAY_COUNT):
+                    self.limiter.cancel_pending(i)
+                    self.set_relay(i, False, 0)
+                # A replayed desired-state document must not switch anything back on
+                self.held_mask = ALL_RELAYS
+            self.send_delta()
+            return
+
+        # stop and off: is_emergency() admits nothing else
+        command = decode_command(dict(doc, action="off"))
+        if command is None or not 0 <= command["relay"] < RELAY_COUNT:
+            return
+        command["receivedAt"] = received_at
+        command["decodedAt"] = self.micros()
+        with self.lock:
+            self.limiter.cancel_pending(command["relay"])
+            self.held_mask |= 1 << command["relay"]
+        self.apply_command(command, deferred=False)
+        self.send_delta()
+
+    def handle_query(self, request):
+        query = request.get("query", "snapshot")
+        response = {"correlationId": request.get("correlationId"), "query": query, "status": "ok"}
+        with self.lock:
+            if query == "snapshot":
+                response.update({"ip": "127.0.0.1", "rssi": -50, "uptime": self.millis(),
+                                 "version": self.version, "groups": list(self.groups)})
+                wanted = range(RELAY_COUNT)
+            elif query == "relays":
+                response["version"] = self.version
+                wanted = request.get("relays")
+                if not isinstance(wanted, list):
+                    wanted = range(RELAY_COUNT)
+            else:
+                wanted = None
+            if wanted is not None:
+                response["relays"] = [{"index": i, "state": self.relay_states[i], "timer": self.relay_timers[i]}
+                                      for i in wanted if isinstance(i, int) and 0 <= i < RELAY_COUNT]
+            elif query == "config":
+                response["config"] = {"heartbeatMs": self.heartbeat_ms, "groups": list(self.groups)}
+            elif query == "metrics":
+                response["metrics"] = {"commands": dict(self.limiter.metrics)}
+            else:
+                response["status"] = "error"
+                response["error"] = "unknown query"
+
+        reply_to = request.get("replyTo") or self.topic("response")
+        if not is_response_topic(reply_to):
+            self.counters.add("query_rejected")
+            return
+        response["deviceId"] = self.device_id
+        response["timestamp"] = self.millis()
+        self.publish(reply_to, response)
+
+    def set_desired(self, payload):
+        """ShadowManager::setDesired and reconcile()."""
+        with self.lock:
+            if not payload:
+                self.desired = None
+                self.shadow_report_pending = True
+                return
+            doc = self.parse(payload)
+            try:
+                version = int(doc.get("version", 0))
+                mask = int(doc.get("mask", 0))
+                timers = {int(k): int(v) for k, v in (doc.get("timers") or {}).items()}
+            except (AttributeError, TypeError, ValueError):
+                self.counters.add("desired_rejected")
+                return
+            if version == 0 or mask & ~ALL_RELAYS or any(
+                    not 0 <= relay < RELAY_COUNT or not mask & (1 << relay) or not 0 < seconds <= MAX_TIMER_S
+                    for relay, seconds in timers.items()):
+                self.counters.add("desired_rejected")
+                return
+
+            # A newer document takes back the relays switched locally under the previous one
+            if self.desired is None or version != self.desired[0]:
+                self.held_mask = 0
+            self.desired = (version, mask, timers)
+
+            timed = sum(1 << relay for relay in timers)
+            for i in range(RELAY_COUNT):
+                bit = 1 << i
+                if timed & bit or self.held_mask & bit:
+                    continue
+                wanted = bool(mask & bit)
+                if self.relay_states[i] != wanted or self.relay_timers[i]:
+                    self.set_relay(i, wanted, 0)
+                    self.counters.add("desired_corrections")
+            # Timers run once per version, so a replayed document does not run them again
+            if version != self.applied_desired:
+                for relay, seconds in timers.items():
+                    if not self.held_mask & (1 << relay):
+                        self.set_relay(relay, True, self.millis() + seconds * 1000)
+                self.applied_desired = version
+            self.shadow_report_pending = True
+
+    def send_reported(self):
+        with self.lock:
+            due = self.shadow_report_pending or (self.desired is not None and
+                                                 self.version != self.shadow_reported_version)
+            if not due:
+                return
+            now = self.millis()
+            reported = {
+                "mask": sum(1 << i for i in range(RELAY_COUNT) if self.relay_states[i]),
+                "timers": {str(i): max(0, t - now) // 1000 for i, t in enumerate(self.relay_timers) if t},
+                "pulsingMask": 0,
+                "version": self.version,
+            }
+            if self.desired is not None:
+                version, mask, timers = self.desired
+                delta = 0
+                for i in range(RELAY_COUNT):
+                    if i not in timers and (self.relay_states[i] != bool(mask & (1 << i)) or self.relay_timers[i]):
+                        delta |= 1 << i
+                reported.update({"desiredVersion": version, "deltaMask": delta, "heldMask": self.held_mask})
+            state_version = self.version
+        reported.update({"deviceId": self.device_id, "timestamp": now})
+        info = self.client.publish(self.topic("reported"), dumps(reported), retain=True)
+        if info.rc == mqtt.MQTT_ERR_SUCCESS:
+            self.counters.add("device_tx")
+            with self.lock:
+                self.shadow_report_pending = False
+                self.shadow_reported_version = state_version
+
+    def apply_config(self, doc):
+        changed = []
+        errors = []
+        if "heartbeatMs" in doc:
+            heartbeat_ms = int(doc["heartbeatMs"])
+            if not MIN_HEARTBEAT_MS <= heartbeat_ms <= MAX_HEARTBEAT_MS:
+                errors.append("heartbeatMs out of range")
+            elif heartbeat_ms != self.heartbeat_ms:
+                self.heartbeat_ms = heartbeat_ms
+                changed.append("status")
+        if isinstance(doc.get("groups"), list):
+            groups = [str(name) for name in doc["groups"]][:MAX_GROUPS]
+            with self.lock:
+                old, self.groups = self.groups, groups
+            if groups != old:
+                for name in old:
+                    self.client.unsubscribe(group_topic(name))
+                for name in groups:
+                    self.client.subscribe(group_topic(name))
+                changed.append("groups")
+        status = {"deviceId": self.device_id, "source": "mqtt", "changed": changed,
+                  "timestamp": self.millis()}
+        if errors:
+            status["error"] = "; ".join(errors)
+        self.publish(TOPIC_CONFIG_STATUS, status)
+
+    def set_relay(self, relay, state, timer):
+        if self.relay_states[relay] == state and self.relay_timers[relay] == timer:
+            return
+        self.relay_states[relay] = state
+        self.relay_timers[relay] = timer
+        self.version += 1
+
+    def tick(self):
+        now = self.millis()
+        due = []
+        with self.lock:
+            for i in range(RELAY_COUNT):
+                if self.relay_timers[i] and now >= self.relay_timers[i]:
+                    self.set_relay(i, False, 0)
+            command = self.limiter.take_due_command(now)
+            while command is not None:
+                due.append(command)
+                command = self.limiter.take_due_command(now)
+        for command in due:
+            self.apply_command(command, deferred=True)
+
+        if self.reported is None or not self.client.is_connected():
+            return
+        self.send_reported()
+        # The window opens at the first change and is not extended, bounding report latency
+        with self.lock:
+            changed = self.version != self.reported[0]
+        if changed and self.change_seen_at is None:
+            self.change_seen_at = now
+        if self.change_seen_at is not None and now - self.change_seen_at >= DEBOUNCE_MS:
+            self.send_delta()
+        if now - self.last_heartbeat >= self.heartbeat_ms:
+            self.publish(TOPIC_HEARTBEAT, {
+                "deviceId": self.device_id,
+                "rssi": -50,
+                "uptime": now,
+                "version": self.reported[0],
+            })
+            self.last_heartbeat = now
+
+    def send_delta(self):
+        with self.lock:
+            if self.reported is None or self.version == self.reported[0]:
+                self.change_seen_at = None
+                return
+            from_version, states, timers = self.reported
+            relays = [{"index": i, "state": self.relay_states[i], "timer": self.relay_timers[i]}
+                      for i in range(RELAY_COUNT)
+                      if self.relay_states[i] != states[i] or self.relay_timers[i] != timers[i]]
+            current = (self.version, list(self.relay_states), list(self.relay_timers))
+        if self.publish(TOPIC_STATUS_DELTA, {
+            "from": from_version,
+            "version": current[0],
+            "relays": relays,
+            "deviceId": self.device_id,
+            "timestamp": self.millis(),
+        }):
+            self.reported = current
+            self.change_seen_at = None
+
+    def send_device_status(self):
+        with self.lock:
+            relays = [{"index": i, "state": self.relay_states[i], "timer": self.relay_timers[i]}
+                      for i in range(RELAY_COUNT)]
+            current = (self.version, list(self.relay_states), list(self.relay_timers))
+        if self.publish(TOPIC_DEVICE_STATUS, {
+            "deviceId": self.device_id,
+            "timestamp": self.millis(),
+            "ip": "127.0.0.1",
+            "rssi": -50,
+            "uptime": self.millis(),
+            "version": current[0],
+            "relays": relays,
+        }):
+            self.reported = current
+            self.change_seen_at = None
+            # The snapshot carries everything a heartbeat would
+            self.last_heartbeat = self.millis()
+
+    def publish(self, topic, doc):
+        info = self.client.publish(topic, dumps(doc))
+        if info.rc == mqtt.MQTT_ERR_SUCCESS:
+            self.counters.add("device_tx")
+            return True
+        return False
+
+
+class Backend:
+    """Sends command storms and matches traced relay-status replies and query responses
+    to measure latency."""
+
+    def __init__(self, args, counters):
+        self.args = args
+        self.counters = counters
+        self.pending = {}       # traceId -> [sent at, replies still expected]
+        self.latencies = []
+        self.next_trace = 0
+        self.queries = {}       # correlationId -> sent at
+        self.query_latencies = []
+        self.next_query = 0
+        self.desired_version = 0
+        self.lock = threading.Lock()
+        self.broker_stats = {}
+        self.client = make_client("GT-sim-backend")
+        self.client.on_connect = self.on_connect
+        self.client.on_message = self.on_message
+
+    def start(self):
+        self.client.connect(self.args.host, self.args.port, keepalive=30)
+        self.client.loop_start()
+
+    def stop(self):
+        self.client.loop_stop()
+        self.client.disconnect()
+
+    def on_connect(self, client, userdata, flags, rc):
+        for topic in (TOPIC_RELAY_STATUS, TOPIC_DEVICE_STATUS, TOPIC_STATUS_DELTA, TOPIC_HEARTBEAT,
+                      TOPIC_CONFIG_STATUS, TOPIC_BACKEND_RESPONSE, "green-tech/+/reported"):
+            client.subscribe(topic)
+        client.subscribe("$SYS/broker/load/messages/+/1min")
+        client.subscribe("$SYS/broker/clients/connected")
+
+    def on_message(self, client, userdata, msg):
+        if msg.topic.startswith("$SYS/"):
+            self.broker_stats[msg.topic[len("$SYS/broker/"):]] = msg.payload.decode(errors="replace")
+            return
+        counter = {
+            TOPIC_DEVICE_STATUS: "device_status_rx",
+            TOPIC_STATUS_DELTA: "status_delta_rx",
+            TOPIC_HEARTBEAT: "heartbeat_rx",
+            TOPIC_CONFIG_STATUS: "config_status_rx",
+        }.get(msg.topic)
+        if counter:
+            self.counters.add(counter)
+            return
+        if msg.topic.endswith("/reported"):
+            # Retained copies from earlier runs are not traffic of this one
+            if not msg.retain:
+                self.counters.add("reported_rx")
+            return
+
+        now = time.monotonic()
+        try:
+            doc = json.loads(msg.payload)
+        except ValueError:
+            return
+        if msg.topic == TOPIC_BACKEND_RESPONSE:
+            self.counters.add("query_responses" if doc.get("status") == "ok" else "query_errors")
+            with self.lock:
+                sent_at = self.queries.pop(doc.get("correlationId"), None)
+                if sent_at is not None:
+                    self.query_latencies.append((now - sent_at) * 1000.0)
+            return
+        self.counters.add("relay_status_rx")
+        trace_id = (doc.get("trace") or {}).get("id")
+        if not trace_id:
+            return
+        with self.lock:
+            entry = self.pending.get(trace_id)
+            if entry is None:
+                self.counters.add("unmatched_replies")
+                return
+            self.latencies.append((now - entry[0]) * 1000.0)
+            entry[1] -= 1
+            if entry[1] <= 0:
+                del self.pending[trace_id]
+        self.counters.add("traced_replies")
+
+    def trace(self, doc, expected):
+        """Adds a traceId to a command when it is sampled for tracing."""
+        if random.random() >= self.args.trace_fraction:
+            return
+        with self.lock:
+            self.next_trace += 1
+            trace_id = "sim-%x" % self.next_trace
+            self.pending[trace_id] = [time.monotonic(), expected]
+        doc["traceId"] = trace_id
+        doc["sentAt"] = int(time.time() * 1000)
+        self.counters.add("traced_tx", expected)
+
+    @staticmethod
+    def random_command():
+        relay = random.randrange(RELAY_COUNT)
+        action = random.choice(("on", "off", "toggle", "timer"))
+        doc = {"relay": relay, "action": action}
+        if action == "timer":
+            doc["duration"] = random.randint(1, 5)
+        return doc
+
+    def send_command(self, device_id):
+        doc = self.random_command()
+        doc["deviceId"] = device_id
+        self.trace(doc, 1)
+        self.client.publish(TOPIC_RELAY_CONTROL, dumps(doc))
+        self.counters.add("commands_tx")
+
+    def send_emergency(self, device_id):
+        """A stop on the emergency topic, or an off marked priority emergency on the routine one."""
+        doc = {"deviceId": device_id, "relay": random.randrange(RELAY_COUNT)}
+        if random.random() < 0.5:
+            doc["action"] = "stop"
+            topic = TOPIC_RELAY_EMERGENCY
+        else:
+            doc.update({"action": "off", "priority": "emergency"})
+            topic = TOPIC_RELAY_CONTROL
+        self.trace(doc, 1)
+        self.client.publish(topic, dumps(doc), qos=1 if topic == TOPIC_RELAY_EMERGENCY else 0)
+        self.counters.add("emergencies_tx")
+
+    def send_query(self, device_id):
+        with self.lock:
+            self.next_query += 1
+            correlation_id = "q-%x" % self.next_query
+            self.queries[correlation_id] = time.monotonic()
+        query = random.choice(("snapshot", "relays", "config", "metrics"))
+        self.client.publish(TOPIC_RELAY_CONTROL, dumps({
+            "deviceId": device_id, "action": "query", "query": query,
+            "replyTo": TOPIC_BACKEND_RESPONSE, "correlationId": correlation_id}))
+        self.counters.add("queries_tx")
+
+    def send_desired(self, device_ids):
+        """A new retained desired-state version for every device, as a backend would keep it."""
+        self.desired_version += 1
+        for device_id in device_ids:
+            doc = {"version": self.desired_version, "mask": random.getrandbits(RELAY_COUNT)}
+            self.client.publish("green-tech/%s/desired" % device_id, dumps(doc), qos=1, retain=True)
+        self.counters.add("desired_tx", len(device_ids))
+
+    def clear_desired(self, device_ids):
+        # An empty retained message deletes the document, so the next run starts clean
+        for device_id in device_ids:
+            self.client.publish("green-tech/%s/desired" % device_id, b"", qos=1, retain=True)
+
+    def send_group_command(self, name, members):
+        doc = self.random_command()
+        if self.args.stagger_ms > 0:
+            doc["staggerMs"] = self.args.stagger_ms
+        self.trace(doc, members)
+        self.client.publish(group_topic(name), dumps(doc))
+        self.counters.add("group_commands_tx")
+
+    def send_config(self, device_id, config):
+        self.client.publish("green-tech/%s/config" % device_id, dumps(config), qos=1)
+        self.counters.add("config_tx")
+
+    def take_latencies(self):
+        with self.lock:
+            samples, self.latencies = self.latencies, []
+        return samples
+
+    def take_query_latencies(self):
+        with self.lock:
+            samples, self.query_latencies = self.query_latencies, []
+        return samples
+
+    def outstanding(self):
+        with self.lock:
+            return sum(entry[1] for entry in self.pending.values())
+
+
+def percentile(sorted_samples, p):
+    if not sorted_samples:
+        return float("nan")
+    k = min(len(sorted_samples) - 1, int(round(p / 100.0 * (len(sorted_samples) - 1))))
+    return sorted_samples[k]
+
+
+def report(elapsed, counters, previous, latencies, backend):
+    current = counters.snapshot()
+    delta = {k: current.get(k, 0) - previous.get(k, 0) for k in current}
+    interval = backend.args.report_interval
+    latencies.sort()
+    print("[%6.1fs] cmd/s=%-6.0f grp/s=%-5.0f dev_rx/s=%-7.0f dev_tx/s=%-6.0f reconnects=%d outstanding=%d" % (
+        elapsed,
+        delta.get("commands_tx", 0) / interval,
+        delta.get("group_commands_tx", 0) / interval,
+        delta.get("device_rx", 0) / interval,
+        delta.get("device_tx", 0) / interval,
+        current.get("reconnects", 0),
+        backend.outstanding()))
+    print("          delta/s=%-6.1f heartbeat/s=%-5.1f reported/s=%-5.1f snapshots=%d config=%d/%d" % (
+        delta.get("status_delta_rx", 0) / interval,
+        delta.get("heartbeat_rx", 0) / interval,
+        delta.get("reported_rx", 0) / interval,
+        current.get("device_status_rx", 0),
+        current.get("config_status_rx", 0),
+        current.get("config_tx", 0)))
+    print("          limiter dropped=%d emergencies=%d/%d queries=%d/%d" % (
+        current.get("limiter_dropped", 0),
+        current.get("emergencies", 0), current.get("emergencies_tx", 0),
+        current.get("query_responses", 0), current.get("queries_tx", 0)))
+    if latencies:
+        print("          latency ms p50=%.1f p90=%.1f p99=%.1f max=%.1f (n=%d)" % (
+            percentile(latencies, 50), percentile(latencies, 90),
+            percentile(latencies, 99), latencies[-1], len(latencies)))
+    if backend.broker_stats:
+        print("          broker " + " ".join("%s=%s" % kv for kv in sorted(backend.broker_stats.items())))
+    return current
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--host", default="127.0.0.1")
+    parser.add_argument("--port", type=int, default=1883)
+    parser.add_argument("--devices", type=int, default=50, help="number of virtual devices")
+    parser.add_argument("--duration", type=float, default=60.0, help="test length in seconds")
+    parser.add_argument("--storm-rate", type=float, default=100.0, help="commands per second during a storm")
+    parser.add_argument("--storm-length", type=float, default=5.0, help="storm length in seconds")
+    parser.add_argument("--storm-every", type=float, default=15.0, help="seconds between storm starts")
+    parser.add_argument("--trace-fraction", type=float, default=1.0,
+                        help="fraction of commands sent with a traceId; the rest are reported as deltas")
+    parser.add_argument("--groups", type=int, default=0,
+                        help="number of groups the fleet is split into over the config topic (0 disables)")
+    parser.add_argument("--group-fraction", type=float, default=0.05,
+                        help="fraction of storm commands sent to a group topic instead of one device")
+    parser.add_argument("--stagger-ms", type=int, default=0, help="staggerMs sent with group commands")
+    parser.add_argument("--emergency-fraction", type=float, default=0.02,
+                        help="fraction of storm commands sent as emergency stops")
+    parser.add_argument("--query-fraction", type=float, default=0.02,
+                        help="fraction of storm commands sent as queries with a replyTo topic")
+    parser.add_argument("--desired-every", type=float, default=30.0,
+                        help="seconds between new desired-state versions for the fleet (0 disables)")
+    parser.add_argument("--reconnect-fraction", type=float, default=0.2,
+                        help="fraction of the fleet dropped per reconnect wave")
+    parser.add_argument("--reconnect-every", type=float, default=20.0,
+                        help="seconds between reconnect waves (0 disables)")
+    parser.add_argument("--heartbeat-ms", type=int, default=300000,
+                        help="heartbeat interval, StatusReporter::DEFAULT_HEARTBEAT_MS in the firmware")
+    parser.add_argument("--config-heartbeat-ms", type=int, default=0,
+                        help="heartbeatMs pushed to every device over the config topic (0 disables)")
+    parser.add_argument("--report-interval", type=float, default=5.0)
+    parser.add_argument("--seed", type=int, default=None)
+    args = parser.parse_args()
+    random.seed(args.seed)
+
+    counters = Counters()
+    devices = [VirtualDevice(i, args, counters) for i in range(args.devices)]
+    backend = Backend(args, counters)
+    backend.start()
+    for device in devices:
+        device.start_device()
+    time.sleep(1.0)
+
+    # Group membership and settings go out over each device's config topic, as in production
+    members = defaultdict(int)
+    groups = ["zone-%d" % g for g in range(args.groups)]
+    for i, device in enumerate(devices):
+        config = {}
+        if groups:
+            config["groups"] = [groups[i % len(groups)]]
+            members[groups[i % len(groups)]] += 1
+        if args.config_heartbeat_ms > 0:
+            config["heartbeatMs"] = args.config_heartbeat_ms
+        if config:
+            backend.send_config(device.device_id, config)
+    time.sleep(0.5)
+
+    start = time.monotonic()
+    next_report = start + args.report_interval
+    next_wave = start + args.reconnect_every if args.reconnect_every > 0 else float("inf")
+    next_desired = start if args.desired_every > 0 else float("inf")
+    device_ids = [device.device_id for device in devices]
+    next_command = start
+    previous = {}
+    all_latencies = []
+
+    try:
+        while True:
+            now = time.monotonic()
+            elapsed = now - start
+            if elapsed >= args.duration:
+                break
+
+            storm_phase = elapsed % args.storm_every
+            if storm_phase < args.storm_length:
+                while next_command <= now:
+                    kind = random.random()
+                    if kind < args.emergency_fraction:
+                        backend.send_emergency(random.choice(device_ids))
+                    elif kind < args.emergency_fraction + args.query_fraction:
+                        backend.send_query(random.choice(device_ids))
+                    elif groups and random.random() < args.group_fraction:
+                        name = random.choice(groups)
+                        backend.send_group_command(name, members[name])
+                    else:
+                        backend.send_command(random.choice(device_ids))
+                    next_command += 1.0 / args.storm_rate
+            else:
+                next_command = now
+
+            for device in devices:
+                device.tick()
+
+            if now >= next_desired:
+                backend.send_desired(device_ids)
+                next_desired = now + args.desired_every
+
+            if now >= next_wave:
+                wave = random.sample(devices, int(len(devices) * args.reconnect_fraction))
+                for device in wave:
+                    device.reconnect()
+                next_wave = now + args.reconnect_every
+
+            if now >= next_report:
+                samples = backend.take_latencies()
+                all_latencies.extend(samples)
+                previous = report(elapsed, counters, previous, samples, backend)
+                next_report = now + args.report_interval
+
+            time.sleep(0.001)
+    except KeyboardInterrupt:
+        pass
+
+    # Let staggered group commands and pending deltas drain
+    drain_until = time.monotonic() + 1.0 + args.stagger_ms / 1000.0
+    while time.monotonic() < drain_until:
+        for device in devices:
+            device.tick()
+        time.sleep(0.01)
+    all_latencies.extend(backend.take_latencies())
+    all_latencies.sort()
+    query_latencies = sorted(backend.take_query_latencies())
+    totals = counters.snapshot()
+    limiter = defaultdict(int)
+    for device in devices:
+        with device.lock:
+            for name, value in device.limiter.metrics.items():
+                limiter[name] += value
+    print("==========================================")
+    print("devices=%d commands=%d group_commands=%d traced=%d replies=%d lost=%d reconnects=%d" % (
+        args.devices, totals.get("commands_tx", 0), totals.get("group_commands_tx", 0),
+        totals.get("traced_tx", 0), totals.get("traced_replies", 0), backend.outstanding(),
+        totals.get("reconnects", 0)))
+    print("deltas=%d heartbeats=%d snapshots=%d config_status=%d" % (
+        totals.get("status_delta_rx", 0), totals.get("heartbeat_rx", 0),
+        totals.get("device_status_rx", 0), totals.get("config_status_rx", 0)))
+    print("limiter applied=%d dropped=%d deferred=%d coalesced=%d staggered=%d" % (
+        limiter["applied"], limiter["dropped"], limiter["deferred"], limiter["coalesced"], limiter["staggered"]))
+    print("emergencies=%d/%d ignored=%d queries=%d/%d errors=%d desired=%d corrections=%d reported=%d" % (
+        totals.get("emergencies", 0), totals.get("emergencies_tx", 0), totals.get("emergency_ignored", 0),
+        totals.get("query_responses", 0), totals.get("queries_tx", 0), totals.get("query_errors", 0),
+        totals.get("desired_tx", 0), totals.get("desired_corrections", 0), totals.get("reported_rx", 0)))
+    if all_latencies:
+        print("latency ms p50=%.1f p90=%.1f p99=%.1f p99.9=%.1f max=%.1f" % (
+            percentile(all_latencies, 50), percentile(all_latencies, 90), percentile(all_latencies, 99),
+            percentile(all_latencies, 99.9), all_latencies[-1]))
+    if query_latencies:
+        print("query ms p50=%.1f p99=%.1f max=%.1f (n=%d)" % (
+            percentile(query_latencies, 50), percentile(query_latencies, 99), query_latencies[-1],
+            len(query_latencies)))
+
+    if args.desired_every > 0:
+        backend.clear_desired(device_ids)
+    for device in devices:
+        device.stop_device()
+    backend.stop()
+
+
+if __name__ == "__main__":
+    main()
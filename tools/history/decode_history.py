@@ -0,0 +1,101 @@
+#!/usr/bin/env python3
+"""
+Decodes compressed history chunks published on green-tech/history.
+
+Reads one JSON message per line (as printed by `mosquitto_sub -t green-tech/history`)
+and prints one CSV row per record: bootId,series,timestamp_ms,value.
+The chunk format is documented in src/TimeSeriesStore/GorillaChunk.h.
+"""
+
+import base64
+import json
+import struct
+import sys
+
+HEADER = struct.Struct("<HHIIIHH")
+MAGIC = 0x4753
+SERIES_NAMES = {0: "relays", 1: "moisture", 2: "temperature", 3: "flow"}
+
+
+class BitReader:
+    def __init__(self, data, bit_count):
+        self.data = data
+        self.bit_count = bit_count
+        self.pos = 0
+
+    def read(self, bits):
+        value = 0
+        for _ in range(bits):
+            if self.pos >= self.bit_count:
+                raise EOFError
+            byte = self.data[self.pos >> 3]
+            value = (value << 1) | ((byte >> (7 - (self.pos & 7))) & 1)
+            self.pos += 1
+        return value
+
+
+def signed(value, bits):
+    return value - (1 << bits) if value & (1 << (bits - 1)) else value
+
+
+def decode_chunk(raw):
+    magic, bit_count, sequence, boot_id, start_time, record_count, _ = HEADER.unpack_from(raw)
+    if magic != MAGIC:
+        raise ValueError("bad chunk magic")
+    reader = BitReader(raw[HEADER.size:], bit_count)
+    state = {}
+    for _ in range(record_count):
+        series = reader.read(3)
+        s = state.get(series)
+        if s is None:
+            timestamp = reader.read(32)
+            value = reader.read(32)
+            s = state[series] = {"ts": timestamp, "delta": 0, "value": value, "window": None}
+        else:
+            if reader.read(1) == 0:
+                dod = 0
+            elif reader.read(1) == 0:
+                dod = signed(reader.read(7), 7)
+            elif reader.read(1) == 0:
+                dod = signed(reader.read(9), 9)
+            elif reader.read(1) == 0:
+                dod = signed(reader.read(12), 12)
+            else:
+                dod = signed(reader.read(32), 32)
+            s["delta"] += dod
+            s["ts"] = (s["ts"] + s["delta"]) & 0xFFFFFFFF
+
+            if reader.read(1) == 1:
+                if reader.read(1) == 0:
+                    leading, trailing = s["window"]
+                    meaningful = reader.read(32 - leading - trailing)
+                else:
+                    leading = reader.read(5)
+                    length = reader.read(6) + 1
+                    trailing = 32 - leading - length
+                    meaningful = reader.read(length)
+                    s["window"] = (leading, trailing)
+                s["value"] ^= meaningful << trailing
+        yield boot_id, series, s["ts"], s["value"]
+
+
+def format_value(series, value):
+    if series == 0:
+        return "0x%05x" % value
+    return "%.1f" % (signed(value, 32) / 10.0)
+
+
+def main():
+    print("bootId,series,timestamp_ms,value")
+    for line in sys.stdin:
+        line = line.strip()
+        if not line:
+            continue
+        message = json.loads(line)
+        for boot_id, series, timestamp, value in decode_chunk(base64.b64decode(message["data"])):
+            print("%08x,%s,%d,%s" % (boot_id, SERIES_NAMES.get(series, series), timestamp,
+                                     format_value(series, value)))
+
+
+if __name__ == "__main__":
+    main()